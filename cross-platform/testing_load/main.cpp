@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "command_line_parser.hpp"
+
+// keeps --connections keep-alive connections open to a server with one request in flight on each, and reports
+// the throughput and latency over --duration seconds; run it against web_testing_server built with and without
+// USE_IO_URING to compare the reactors
+//
+// web_testing_load --ip 127.0.0.1 --port 54321 --connections 10000 --duration 30 --threads 4
+
+namespace
+{
+	using tcp = boost::asio::ip::tcp;
+	using clock_type = std::chrono::steady_clock;
+
+	// connects started at once while the connections are opened, more overflow the listen backlog
+	constexpr size_t MAX_PENDING_CONNECTS = 256;
+
+	// latencies in microseconds, exact below 64 and within 2% above
+	class latency_histogram
+	{
+	public:
+		void add(const uint64_t value) noexcept
+		{
+			m_buckets[std::min(get_bucket(value), m_buckets.size() - 1)]++;
+		}
+
+		void clear() noexcept
+		{
+			for (auto& bucket : m_buckets)
+				bucket = 0;
+		}
+
+		uint64_t get_percentile(const double percentile) const noexcept
+		{
+			uint64_t total = 0;
+
+			for (const auto& bucket : m_buckets)
+				total += bucket;
+
+			const auto target = static_cast<uint64_t>(total * percentile);
+			uint64_t seen = 0;
+
+			for (size_t i = 0; i < m_buckets.size(); i++)
+			{
+				seen += m_buckets[i];
+
+				if (seen > target)
+					return get_value(i);
+			}
+
+			return 0;
+		}
+
+	private:
+		static size_t get_bucket(const uint64_t value) noexcept
+		{
+			if (value < 64)
+				return static_cast<size_t>(value);
+
+			size_t msb = 6;
+
+			while ((value >> (msb + 1)) != 0)
+				msb++;
+
+			return (msb - 5) * 64 + static_cast<size_t>((value >> (msb - 6)) & 63);
+		}
+
+		static uint64_t get_value(const size_t bucket) noexcept
+		{
+			if (bucket < 64)
+				return bucket;
+
+			return (64 + bucket % 64) << (bucket / 64 - 1);
+		}
+
+		// up to about 2^40 us
+		std::array<std::atomic<uint64_t>, 36 * 64> m_buckets{};
+	};
+
+	struct load_stats
+	{
+		std::atomic<uint64_t> m_nr_connected = 0;
+		std::atomic<uint64_t> m_nr_failed_connects = 0;
+		std::atomic<uint64_t> m_nr_responses = 0;
+		std::atomic<uint64_t> m_nr_errors = 0;
+		latency_histogram m_latencies;
+		std::atomic<bool> m_running = true;
+	};
+
+	class connection : public std::enable_shared_from_this<connection>
+	{
+	public:
+		connection(boost::asio::io_context& context, const std::string& request, load_stats& stats)
+			: m_socket(context), m_request(request), m_stats(stats)
+		{
+		}
+
+		void start(const tcp::endpoint& endpoint, std::function<void()> on_connected)
+		{
+			m_socket.async_connect(endpoint, [self = shared_from_this(), on_connected](const boost::system::error_code& err) {
+				if (err)
+				{
+					self->m_stats.m_nr_failed_connects++;
+				}
+				else
+				{
+					self->m_stats.m_nr_connected++;
+					self->m_socket.set_option(tcp::no_delay(true));
+					self->send();
+				}
+
+				on_connected();
+			});
+		}
+
+	private:
+		void send()
+		{
+			if (!m_stats.m_running)
+			{
+				return;
+			}
+
+			m_sent = clock_type::now();
+
+			boost::asio::async_write(m_socket, boost::asio::buffer(m_request), [self = shared_from_this()](const boost::system::error_code& err, size_t) {
+				if (err)
+				{
+					self->m_stats.m_nr_errors++;
+					return;
+				}
+
+				self->read_header();
+			});
+		}
+
+		void read_header()
+		{
+			boost::asio::async_read_until(m_socket, m_buffer, "\r\n\r\n", [self = shared_from_this()](const boost::system::error_code& err, size_t header_size) {
+				if (err)
+				{
+					self->m_stats.m_nr_errors++;
+					return;
+				}
+
+				self->read_body(header_size, self->get_content_length(header_size));
+			});
+		}
+
+		void read_body(const size_t header_size, const size_t body_size)
+		{
+			const size_t needed = header_size + body_size;
+
+			if (m_buffer.size() >= needed)
+			{
+				m_buffer.consume(needed);
+				on_response();
+				return;
+			}
+
+			boost::asio::async_read(m_socket, m_buffer, boost::asio::transfer_exactly(needed - m_buffer.size()),
+				[self = shared_from_this(), header_size, body_size](const boost::system::error_code& err, size_t) {
+					if (err)
+					{
+						self->m_stats.m_nr_errors++;
+						return;
+					}
+
+					self->read_body(header_size, body_size);
+				});
+		}
+
+		size_t get_content_length(const size_t header_size) const
+		{
+			std::string header(boost::asio::buffers_begin(m_buffer.data()), boost::asio::buffers_begin(m_buffer.data()) + header_size);
+
+			std::transform(header.begin(), header.end(), header.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+			if (auto it = header.find("\r\ncontent-length:"); it != std::string::npos)
+			{
+				return std::strtoull(header.c_str() + it + 17, nullptr, 10);
+			}
+
+			return 0;
+		}
+
+		void on_response()
+		{
+			m_stats.m_nr_responses++;
+			m_stats.m_latencies.add(std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - m_sent).count());
+
+			send();
+		}
+
+		tcp::socket m_socket;
+		const std::string& m_request;
+		load_stats& m_stats;
+		boost::asio::streambuf m_buffer;
+		clock_type::time_point m_sent;
+	};
+
+	size_t get_number_option(utile::command_line_parser& cmd_parser, const std::string& name, const size_t default_value)
+	{
+		auto option = cmd_parser.get_option(name);
+
+		return option ? std::stoull(std::string(*option)) : default_value;
+	}
+
+	void raise_file_limit()
+	{
+#ifndef _WIN32
+		rlimit limit{};
+
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+		{
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit(RLIMIT_NOFILE, &limit);
+		}
+#endif
+	}
+}
+
+int main(int argc, char* argv[]) try
+{
+	utile::command_line_parser cmd_parser(argc, argv);
+
+	auto server_ip = std::string(cmd_parser.get_option("--ip").value_or("127.0.0.1"));
+	auto server_port = static_cast<unsigned short>(get_number_option(cmd_parser, "--port", 54321));
+	auto path = std::string(cmd_parser.get_option("--path").value_or("/test/id=1"));
+	auto nr_connections = get_number_option(cmd_parser, "--connections", 1000);
+	auto duration = std::chrono::seconds(get_number_option(cmd_parser, "--duration", 10));
+	auto nr_threads = std::max<size_t>(get_number_option(cmd_parser, "--threads", std::thread::hardware_concurrency()), 1);
+
+	raise_file_limit();
+
+	const std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + server_ip + "\r\nConnection: keep-alive\r\n\r\n";
+	const tcp::endpoint endpoint(boost::asio::ip::make_address(server_ip), server_port);
+
+	boost::asio::io_context context;
+	auto work = boost::asio::make_work_guard(context);
+	load_stats stats;
+
+	std::vector<std::thread> threads;
+
+	for (size_t i = 0; i < nr_threads; i++)
+	{
+		threads.emplace_back([&context]() { context.run(); });
+	}
+
+	// every finished connect starts the next one, so at most MAX_PENDING_CONNECTS are in flight
+	std::atomic<size_t> next_connection = 0;
+	std::function<void()> open_next;
+
+	open_next = [&]() {
+		if (size_t i = next_connection++; i < nr_connections)
+		{
+			std::make_shared<connection>(context, request, stats)->start(endpoint, open_next);
+		}
+	};
+
+	auto opening_started = clock_type::now();
+
+	for (size_t i = 0; i < std::min(nr_connections, MAX_PENDING_CONNECTS); i++)
+	{
+		boost::asio::post(context, open_next);
+	}
+
+	while (stats.m_nr_connected + stats.m_nr_failed_connects < nr_connections)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	auto opening_time = std::chrono::duration<double>(clock_type::now() - opening_started).count();
+
+	// only the steady state is measured, not the responses while the connections were opened
+	stats.m_latencies.clear();
+	stats.m_nr_responses = 0;
+
+	std::this_thread::sleep_for(duration);
+
+	const uint64_t nr_responses = stats.m_nr_responses;
+
+	stats.m_running = false;
+
+	std::printf("connections: %llu opened, %llu failed in %.2fs\n", (unsigned long long)stats.m_nr_connected, (unsigned long long)stats.m_nr_failed_connects, opening_time);
+	std::printf("responses: %llu, %.0f/s, %llu errors\n", (unsigned long long)nr_responses, nr_responses / std::chrono::duration<double>(duration).count(), (unsigned long long)stats.m_nr_errors);
+	std::printf("latency us: p50 %llu, p90 %llu, p99 %llu, p99.9 %llu\n",
+		(unsigned long long)stats.m_latencies.get_percentile(0.5), (unsigned long long)stats.m_latencies.get_percentile(0.9),
+		(unsigned long long)stats.m_latencies.get_percentile(0.99), (unsigned long long)stats.m_latencies.get_percentile(0.999));
+	std::fflush(stdout);
+
+	// the connections are dropped with the process, waiting for their last responses isn't worth it
+	std::_Exit(stats.m_nr_connected == 0 ? 1 : 0);
+}
+catch (const std::exception& err)
+{
+	std::cerr << err.what();
+	return 1;
+}
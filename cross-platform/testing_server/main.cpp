@@ -16,7 +16,13 @@ int main(int argc, char* argv[]) try
     // auto server_ip = "127.0.0.1";
     // auto server_port = 54321;
     
-	net::web_server server(server_ip, server_port);
+	// a load test (web_testing_load) needs more than the default
+	auto max_connections = cmd_parser.get_option("--max-connections");
+	auto nr_threads = cmd_parser.get_option("--threads");
+
+	net::web_server server(server_ip, server_port,
+		max_connections ? std::stoull(std::string(*max_connections)) : 1000,
+		nr_threads ? std::stoull(std::string(*nr_threads)) : 4);
 
 	// add callbacks	
 	net::async_req_handle_callback test_callback = [](std::shared_ptr<net::http_request> req) {
@@ -1,15 +1,25 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
+#include <cerrno>
+#include <chrono>
 #include <future>
 #include <memory>
+#include <optional>
 
 #include "http_request.hpp"
 #include "http_response.hpp"
 #include "../utile/timer.hpp"
 #include "web_message_controller.hpp"
+#include "web_message_pipeline.hpp"
+#include "redirect_cache.hpp"
+#include "response_cache.hpp"
+#include "endpoint_racer.hpp"
+#include "dns_cache.hpp"
 #include "../utile/data_types.hpp"
 
 #ifdef __linux__
@@ -19,17 +29,39 @@
 
 namespace net
 {
+	typedef std::function<void(utile::web_error)> async_connect_callback;
+
 	template <typename T>
 	class base_web_client
 	{
 	public:
+		// runs its own io_service on a thread of its own
 		base_web_client() :
-			m_idle_work(m_io_service),
-			m_controller(m_socket)
+			m_owned_io_service(std::make_unique<boost::asio::io_service>()),
+			m_io_service(*m_owned_io_service),
+			m_controller(m_socket),
+			m_pipeline(m_socket)
 		{
+			m_idle_work.emplace(m_io_service);
+			m_pipeline.set_pipeline_broken_callback(std::bind(&base_web_client::on_pipeline_broken, this, std::placeholders::_1, std::placeholders::_2));
+			m_controller.set_permanent_redirect_callback(std::bind(&base_web_client::on_permanent_redirect, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+			set_content_decoding(true);
+
 			m_thread_context = std::thread([this]() { m_io_service.run(); });
 		}
 
+		// handlers run on whoever runs io_context, so many clients can share a few threads (see io_context_pool);
+		// io_context has to be run by a single thread and the client must only be destroyed once its requests completed
+		base_web_client(boost::asio::io_context& io_context) :
+			m_io_service(io_context),
+			m_controller(m_socket),
+			m_pipeline(m_socket)
+		{
+			m_pipeline.set_pipeline_broken_callback(std::bind(&base_web_client::on_pipeline_broken, this, std::placeholders::_1, std::placeholders::_2));
+			m_controller.set_permanent_redirect_callback(std::bind(&base_web_client::on_permanent_redirect, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+			set_content_decoding(true);
+		}
+
 		virtual ~base_web_client()
 		{
 			if (m_socket->lowest_layer().is_open())
@@ -37,12 +69,23 @@ namespace net
 				disconnect();
 			}
 
+			if (m_owned_io_service == nullptr)
+			{
+				// the io_context is not ours to stop
+				return;
+			}
+
 			m_io_service.stop();
 
 			if (m_thread_context.joinable())
 				m_thread_context.join();
 		}
 
+		boost::asio::io_context& get_io_context() noexcept
+		{
+			return m_io_service;
+		}
+
 		bool connect(const std::string& url, const utile::PORT& port)
 		{
 			return connect(url, std::to_string(port));
@@ -50,6 +93,15 @@ namespace net
 
 		virtual bool connect(const std::string& url, const std::optional<std::string>& port = std::nullopt) noexcept = 0;
 
+		void async_connect(const std::string& url, const utile::PORT& port, const async_connect_callback& callback, const uint16_t timeout = 0) noexcept
+		{
+			async_connect(url, std::to_string(port), callback, timeout);
+		}
+
+		// resolves, connects and handshakes without blocking the io thread, the callback runs on it once done;
+		// the socket is closed if it didn't finish within timeout milliseconds, 0 means no deadline
+		virtual void async_connect(const std::string& url, const std::optional<std::string>& port, const async_connect_callback& callback, const uint16_t timeout = 0) noexcept = 0;
+
 		// to be called if you want to cancel async request
 		void disconnect()
 		{
@@ -60,12 +112,75 @@ namespace net
 			}
 		}
 
+		// false if either side closed the connection, only meaningful while no request is ongoing
+		bool is_connection_alive() noexcept
+		{
+			std::scoped_lock lock(m_mutex);
+
+			auto& socket = m_socket->lowest_layer();
+
+			if (!socket.is_open())
+			{
+				return false;
+			}
+
+			boost::system::error_code errcode;
+			const bool was_non_blocking = socket.non_blocking();
+
+			if (socket.non_blocking(true, errcode); errcode)
+			{
+				return false;
+			}
+
+			char data = 0;
+			auto rez = ::recv(socket.native_handle(), &data, 1, MSG_PEEK);
+
+#ifdef _WIN32
+			const bool would_block = rez < 0 && WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+			const bool would_block = rez < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+#endif
+			socket.non_blocking(was_non_blocking, errcode);
+
+			// 0 bytes means the peer closed the connection, unsolicited data means it can't be reused either
+			return would_block;
+		}
+
 		std::pair<std::shared_ptr<http_response>, utile::web_error> send(http_request&& request, const uint16_t timeout = 0, const bool should_follow_redirects = false)
 		{
-			request.set_host(m_host);
+			if (!m_pipeline.empty())
+			{
+				return { nullptr, REQUEST_ALREADY_ONGOING };
+			}
+
+			if (should_follow_redirects)
+			{
+				if (auto location = redirect_cache::get_instance().lookup(m_url, m_port, request.get_method()); location != std::nullopt && !follow_cached_redirect(request, *location))
+				{
+					return { nullptr, utile::web_error(std::error_code(ERROR_INVALID_ADDRESS, std::generic_category()), "Bad redirect") };
+				}
+			}
+
+			if (m_use_response_cache)
+			{
+				if (auto cached = response_cache::get_instance().prepare(m_url, m_port, request); cached != nullptr)
+				{
+					return { cached, utile::web_error() };
+				}
+			}
+
+			const auto method = request.get_method();
+			const auto type = request.get_type();
+
+			prepare_request(request);
 
 			auto rez = m_controller.send(std::move(request), timeout, should_follow_redirects);
 
+			if (m_use_response_cache && type == request_type::GET && rez.second)
+			{
+				rez.first = response_cache::get_instance().on_response(m_url, m_port, method, rez.first);
+			}
+
 			if (should_follow_redirects && rez.second.value() == 301) try
 			{
 				auto redirect_json_data = nlohmann::json::parse(rez.second.message());
@@ -81,7 +196,7 @@ namespace net
 				{
 					disconnect();
 
-					if (connect(redirect_data->m_host, redirect_data->m_port))
+					if (connect(redirect_data->m_host, to_port(redirect_data->m_port)))
 					{
 						request.set_host(m_host);
 						request.set_method(redirect_data->m_method);
@@ -105,43 +220,92 @@ namespace net
 
 		void send_async(http_request&& request, async_get_callback& callback, const uint16_t timeout = 0, const bool should_follow_redirects = false) noexcept
 		{
-			if (!m_controller.can_send())
+			if (!m_controller.can_send() || !m_pipeline.empty())
 			{
 				if (callback)
 					callback( nullptr, utile::web_error(std::error_code(5, std::generic_category()), "Request already ongoing") );
 				return;
 			}
 
-			m_get_callback = [this, &callback, &request, should_follow_redirects](std::shared_ptr<ihttp_message> message, utile::web_error err) {
-				if (should_follow_redirects && err.value() == 301) try
+			if (should_follow_redirects)
+			{
+				if (auto location = redirect_cache::get_instance().lookup(m_url, m_port, request.get_method()); location != std::nullopt)
+				{
+					if (is_other_host(*location))
+					{
+						follow_cached_redirect_async(request, callback, *location, timeout);
+						return;
+					}
+
+					request.set_method(location->m_method);
+				}
+			}
+
+			if (m_use_response_cache)
+			{
+				if (auto cached = response_cache::get_instance().prepare(m_url, m_port, request); cached != nullptr)
+				{
+					// callbacks always run on the io thread
+					boost::asio::post(m_io_service, [&callback, cached]() {
+						if (callback)
+							callback(cached, utile::web_error());
+						});
+					return;
+				}
+			}
+
+			m_get_callback = [this, &callback, &request, should_follow_redirects, method = request.get_method(), type = request.get_type()](std::shared_ptr<ihttp_message> message, utile::web_error err) {
+				if (!should_follow_redirects || err.value() != 301)
+				{
+					if (m_use_response_cache && type == request_type::GET && err)
+					{
+						message = response_cache::get_instance().on_response(m_url, m_port, method, std::dynamic_pointer_cast<http_response>(message));
+					}
+
+					if (callback)
+						callback(message, err);
+					return;
+				}
+
+				try
 				{
 					auto redirect_json_data = nlohmann::json::parse(err.message());
 
-					auto time_left = 0u;
+					uint16_t time_left = 0;
 
 					if (auto it = redirect_json_data.find("remaining_time");  it != redirect_json_data.end() && it->is_number())
 					{
 						time_left = it->get<uint16_t>();
 					}
 
-					if (auto redirect_data = net::from_json(redirect_json_data); redirect_data != std::nullopt)
+					auto redirect_data = net::from_json(redirect_json_data);
+
+					if (redirect_data == std::nullopt)
 					{
-						disconnect();
+						if (callback)
+							callback(message, utile::web_error(std::error_code(ERROR_INVALID_ADDRESS, std::generic_category()), "Bad redirect"));
+						return;
+					}
 
-						if (connect(redirect_data->m_host, redirect_data->m_port))
-						{
-							request.set_host(m_host);
-							request.set_method(redirect_data->m_method);
+					disconnect();
 
-							send_async(std::move(request), callback, time_left, should_follow_redirects);
-						}
-						else
+					auto port = to_port(redirect_data->m_port);
+					auto started_at = std::chrono::steady_clock::now();
+
+					// this runs on the io thread, connecting to the new host must not block it
+					async_connect(redirect_data->m_host, port, [this, &callback, &request, message, time_left, started_at, method = redirect_data->m_method, should_follow_redirects](utile::web_error err) {
+						if (!err)
 						{
 							// in case of failed connection stop
 							if (callback)
 								callback(message, utile::web_error(std::error_code(ERROR_INVALID_ADDRESS, std::generic_category()), "Bad redirect"));
+							return;
 						}
-					}
+
+						request.set_method(method);
+
+						send_async(std::move(request), callback, remaining_time(time_left, started_at), should_follow_redirects);
+						}, time_left);
 				}
 				catch (const std::exception& err)
 				{
@@ -150,26 +314,448 @@ namespace net
 				}
 			};
 
-			request.set_host(m_host);
+			prepare_request(request);
 
-			m_controller.send_async(std::move(request), callback, timeout, should_follow_redirects);
+			m_controller.send_async(std::move(request), m_get_callback, timeout, should_follow_redirects);
+		}
+
+		// tcp clients only, time a connect attempt gets before the next resolved address is tried in parallel
+		void set_connect_attempt_delay(const std::chrono::milliseconds attempt_delay) noexcept
+		{
+			m_connect_attempt_delay = attempt_delay;
+		}
+
+		// send and send_async answer GET requests from net::response_cache while they're fresh and revalidate them once stale
+		void enable_response_cache() noexcept
+		{
+			m_use_response_cache = true;
+		}
+
+		void disable_response_cache() noexcept
+		{
+			m_use_response_cache = false;
+		}
+
+		// on by default, requests without an Accept-Encoding ask for gzip or deflate and such responses are inflated while they are read;
+		// has to be set while no request is ongoing
+		void set_content_decoding(const bool enabled) noexcept
+		{
+			m_decode_content = enabled;
+			m_controller.set_content_decoding(enabled);
+			m_pipeline.set_content_decoding(enabled);
+		}
+
+		// request bodies of at least min_size bytes are sent gzip compressed, only for servers known to accept them
+		void enable_request_compression(const size_t min_size = 1024) noexcept
+		{
+			m_request_compression_threshold = std::max<size_t>(min_size, 1);
+		}
+
+		void disable_request_compression() noexcept
+		{
+			m_request_compression_threshold = 0;
+		}
+
+		// lets send_pipelined write up to max_depth requests before the first response arrives,
+		// only use it with servers known to answer requests in order
+		void enable_pipelining(const size_t max_depth = 8)
+		{
+			m_pipeline.set_max_depth(max_depth);
+		}
+
+		void disable_pipelining()
+		{
+			m_pipeline.set_max_depth(1);
 		}
+
+		// responses are matched to requests in the order they were sent, the callback is copied so it doesn't have to outlive the call;
+		// can't be mixed with send/send_async while pipelined requests are unanswered
+		void send_pipelined(http_request&& request, const async_get_callback& callback) noexcept
+		{
+			if (!m_controller.can_send())
+			{
+				if (callback)
+					callback(nullptr, REQUEST_ALREADY_ONGOING);
+				return;
+			}
+
+			auto pipelined = std::make_shared<pipelined_request>();
+			pipelined->m_request = std::move(request);
+			prepare_request(pipelined->m_request);
+			pipelined->m_callback = callback;
+
+			m_pipeline.send_async(pipelined);
+		}
+
+		std::future<std::pair<std::shared_ptr<http_response>, utile::web_error>> send_pipelined(http_request&& request) noexcept
+		{
+			auto promise = std::make_shared<std::promise<std::pair<std::shared_ptr<http_response>, utile::web_error>>>();
+			auto future = promise->get_future();
+
+			send_pipelined(std::move(request), [promise](std::shared_ptr<ihttp_message> message, utile::web_error err) {
+				promise->set_value({ std::dynamic_pointer_cast<http_response>(message), err });
+				});
+
+			return future;
+		}
+
 	protected:
 
 		void set_socket(std::shared_ptr<T> socket)
 		{
 			m_socket = socket;
 			m_controller.set_socket(m_socket);
+			m_pipeline.set_socket(m_socket);
+		}
+
+		// called by connect, a broken pipeline reconnects with them
+		void set_connection_data(const std::string& url, const std::string& port)
+		{
+			m_url = url;
+			m_port = port;
 		}
 
-		boost::asio::io_service m_io_service;
-		boost::asio::io_context::work m_idle_work;
+		// one async_connect call, the steps check is_finished so a late completion doesn't act on a timed out attempt
+		struct connect_attempt
+		{
+			connect_attempt(boost::asio::io_context& io_context) : m_deadline(io_context) {}
+
+			async_connect_callback m_callback;
+			boost::asio::steady_timer m_deadline;
+			// stops the step still running when the attempt fails early, e.g. connects racing each other
+			std::function<void()> m_cancel;
+			bool m_finished = false;
+		};
+
+		// has to be called from the io thread, connect steps must run there as well
+		std::shared_ptr<connect_attempt> start_connect_attempt(const async_connect_callback& callback, const uint16_t timeout)
+		{
+			auto attempt = std::make_shared<connect_attempt>(m_io_service);
+			attempt->m_callback = callback;
+
+			if (timeout)
+			{
+				attempt->m_deadline.expires_after(std::chrono::milliseconds(timeout));
+				attempt->m_deadline.async_wait([this, attempt](const boost::system::error_code& error) {
+					if (error)
+					{
+						// canceled, the attempt finished in time
+						return;
+					}
+
+					finish_connect_attempt(attempt, utile::web_error(std::error_code(ETIMEDOUT, std::generic_category()), "Connect timed out"));
+					});
+			}
+
+			return attempt;
+		}
+
+		void finish_connect_attempt(std::shared_ptr<connect_attempt> attempt, utile::web_error err) noexcept
+		{
+			if (attempt->m_finished)
+			{
+				return;
+			}
+
+			attempt->m_finished = true;
+			attempt->m_deadline.cancel();
+
+			if (auto cancel = std::move(attempt->m_cancel); cancel && !err)
+			{
+				cancel();
+			}
+
+			if (!err)
+			{
+				// wakes up whatever step is still pending, it sees the attempt finished and stops
+				std::scoped_lock lock(m_mutex);
+
+				boost::system::error_code ignored;
+				m_socket->lowest_layer().close(ignored);
+			}
+
+			if (attempt->m_callback)
+				attempt->m_callback(err);
+		}
+
+		static bool is_finished(const std::shared_ptr<connect_attempt>& attempt)
+		{
+			return attempt->m_finished;
+		}
+
+		// the tcp part of connect for clients whose socket sits on a tcp socket, before_connect runs once the addresses are known
+		utile::web_error connect_tcp(boost::asio::ip::tcp::resolver& resolver, const std::string& url, const std::string& port, const std::function<void()>& before_connect)
+		{
+			utile::web_error resolve_err;
+			auto endpoints = dns_cache::get_instance().resolve(resolver, url, port, resolve_err);
+
+			if (!resolve_err)
+			{
+				return resolve_err;
+			}
+
+			if (before_connect)
+				before_connect();
+
+			if (auto errcode = endpoint_racer::connect(m_socket->lowest_layer(), endpoints, m_connect_attempt_delay))
+			{
+				// addresses might be stale, next attempt goes through the resolver again
+				dns_cache::get_instance().invalidate(url, port);
+				return utile::web_error(std::error_code(errcode.value(), std::generic_category()), errcode.message());
+			}
+
+			boost::system::error_code ignored;
+			m_socket->lowest_layer().set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+
+			return utile::web_error();
+		}
+
+		// same for async_connect, on_connected continues the attempt on the io thread and has to finish it
+		void async_connect_tcp(boost::asio::ip::tcp::resolver& resolver, const std::string& url, const std::string& port, const async_connect_callback& callback, const uint16_t timeout,
+			const std::function<void()>& before_connect, const std::function<void(std::shared_ptr<connect_attempt>)>& on_connected) noexcept
+		{
+			// every step runs on the io thread, even a cache hit resolving inline
+			boost::asio::post(m_io_service, [this, &resolver, url, port, callback, timeout, before_connect, on_connected]() {
+				{
+					std::scoped_lock lock(m_mutex);
+					if (m_socket->lowest_layer().is_open())
+					{
+						if (callback)
+							callback(utile::web_error(std::error_code(EISCONN, std::generic_category()), "Already connected"));
+						return;
+					}
+				}
+
+				auto attempt = start_connect_attempt(callback, timeout);
+
+				dns_cache::get_instance().async_resolve(resolver, url, port, [this, attempt, url, port, before_connect, on_connected](std::vector<boost::asio::ip::tcp::endpoint> endpoints, utile::web_error err) {
+					if (is_finished(attempt))
+					{
+						return;
+					}
+
+					if (!err)
+					{
+						finish_connect_attempt(attempt, err);
+						return;
+					}
+
+					if (before_connect)
+						before_connect();
+
+					auto racer = endpoint_racer::async_connect(m_socket->lowest_layer(), endpoints, [this, attempt, url, port, on_connected](const boost::system::error_code& error, const boost::asio::ip::tcp::endpoint& /*endpoint*/) {
+						if (is_finished(attempt))
+						{
+							return;
+						}
+
+						if (error)
+						{
+							// addresses might be stale, next attempt goes through the resolver again
+							dns_cache::get_instance().invalidate(url, port);
+							finish_connect_attempt(attempt, utile::web_error(std::error_code(error.value(), std::generic_category()), error.message()));
+							return;
+						}
+
+						boost::system::error_code ignored;
+						m_socket->lowest_layer().set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+
+						on_connected(attempt);
+						}, m_connect_attempt_delay);
+
+					attempt->m_cancel = [weak_racer = std::weak_ptr<endpoint_racer>(racer)]() {
+						// weak, the racer's callback holds the attempt
+						if (auto racer = weak_racer.lock())
+							racer->cancel();
+					};
+					});
+				});
+		}
+
+		static uint16_t remaining_time(const uint16_t timeout, const std::chrono::steady_clock::time_point started_at)
+		{
+			if (timeout == 0)
+			{
+				return 0;
+			}
+
+			auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started_at).count();
+
+			// 1 instead of 0, the budget is used up but 0 would mean no timeout at all
+			return static_cast<uint16_t>(std::max<decltype(elapsed)>(timeout - elapsed, 1));
+		}
+
+		// null when the io_context is owned by someone else
+		std::unique_ptr<boost::asio::io_service> m_owned_io_service = nullptr;
+		boost::asio::io_service& m_io_service;
+		std::optional<boost::asio::io_context::work> m_idle_work;
 		std::string m_host{};
 		std::mutex m_mutex;
 		std::thread m_thread_context;
-		web_message_controller<T> m_controller;
+		// has to be declared before the controller, the controller keeps a copy of it
 		std::shared_ptr<T> m_socket = nullptr;
+		web_message_controller<T> m_controller;
+		web_message_pipeline<T> m_pipeline;
 		async_get_callback m_get_callback;
+		std::string m_url{};
+		std::string m_port{};
+		std::atomic<bool> m_use_response_cache = false;
+		std::atomic<bool> m_decode_content = false;
+		// 0 when request bodies are never compressed
+		std::atomic<size_t> m_request_compression_threshold = 0;
+		std::chrono::milliseconds m_connect_attempt_delay = endpoint_racer::DEFAULT_ATTEMPT_DELAY;
+
+	private:
+		void prepare_request(http_request& request)
+		{
+			request.set_host(m_host);
+
+			if (m_decode_content && request.get_header_value<std::string>("Accept-Encoding") == std::nullopt)
+			{
+				request.set_header_value("Accept-Encoding", "gzip, deflate");
+			}
+
+			auto threshold = m_request_compression_threshold.load();
+
+			if (threshold == 0 || request.get_body_size() < threshold || request.is_body_encoded() || request.get_header_value<std::string>("Transfer-Encoding") != std::nullopt)
+			{
+				return;
+			}
+
+			if (request.gzip_compress_body())
+			{
+				// to_string writes the Content-Length of the compressed body on its own
+				request.remove_header_value("Content-Length");
+			}
+			else
+			{
+				// the body is left as it was, it goes out uncompressed
+				request.remove_header_value("Content-Encoding");
+			}
+		}
+
+		void on_permanent_redirect(const std::string& method, const web_location& location, std::shared_ptr<http_response> response)
+		{
+			redirect_cache::get_instance().store(m_url, m_port, method, location, response);
+		}
+
+		static std::optional<std::string> to_port(const std::string& port)
+		{
+			return port != "" ? std::optional<std::string>(port) : std::nullopt;
+		}
+
+		bool is_other_host(const web_location& location) const
+		{
+			return location.m_host != "" && (location.m_host != m_url || (location.m_port != "" && location.m_port != m_port));
+		}
+
+		// moves the request to where a cached permanent redirect points, reconnecting if it's on another host
+		bool follow_cached_redirect(http_request& request, const web_location& location)
+		{
+			if (is_other_host(location))
+			{
+				auto original_url = m_url;
+				auto original_port = m_port;
+
+				disconnect();
+
+				if (!connect(location.m_host, to_port(location.m_port)))
+				{
+					// the target is gone, forget the redirect and go through the original host again
+					redirect_cache::get_instance().invalidate(original_url, original_port, request.get_method());
+
+					disconnect();
+
+					return connect(original_url, original_port);
+				}
+			}
+
+			request.set_method(location.m_method);
+
+			return true;
+		}
+
+		void follow_cached_redirect_async(http_request& request, async_get_callback& callback, const web_location& location, const uint16_t timeout) noexcept
+		{
+			auto original_url = m_url;
+			auto original_port = m_port;
+			auto original_method = request.get_method();
+			auto started_at = std::chrono::steady_clock::now();
 
+			disconnect();
+
+			async_connect(location.m_host, to_port(location.m_port), [this, &request, &callback, location, original_url, original_port, original_method, timeout, started_at](utile::web_error err) {
+				if (err)
+				{
+					request.set_method(location.m_method);
+
+					send_async(std::move(request), callback, remaining_time(timeout, started_at), true);
+					return;
+				}
+
+				// the target is gone, forget the redirect and go through the original host again
+				redirect_cache::get_instance().invalidate(original_url, original_port, original_method);
+
+				disconnect();
+
+				async_connect(original_url, original_port, [this, &request, &callback, timeout, started_at](utile::web_error err) {
+					if (!err)
+					{
+						if (callback)
+							callback(nullptr, err);
+						return;
+					}
+
+					send_async(std::move(request), callback, remaining_time(timeout, started_at), true);
+					}, remaining_time(timeout, started_at));
+				}, timeout);
+		}
+
+		// the server closed the connection with requests still unanswered, the ones never written and the idempotent ones
+		// are sent again one at a time on a new connection, the others might have been processed already so they fail
+		void on_pipeline_broken(std::deque<std::shared_ptr<pipelined_request>> unanswered, utile::web_error err) noexcept
+		{
+			std::deque<std::shared_ptr<pipelined_request>> retried;
+
+			for (auto& request : unanswered)
+			{
+				if (!request->m_retried && (!request->m_written || request->m_request.is_idempotent()) && m_url != "")
+				{
+					request->m_retried = true;
+					retried.push_back(request);
+				}
+				else if (request->m_callback)
+				{
+					request->m_callback(nullptr, err);
+				}
+			}
+
+			if (retried.empty())
+			{
+				m_pipeline.restart();
+				return;
+			}
+
+			disconnect();
+
+			// this runs on the io thread, requests queued until the connection is back wait in the broken pipeline
+			async_connect(m_url, m_port, [this, retried = std::move(retried)](utile::web_error err) mutable {
+				if (!err)
+				{
+					for (auto& request : retried)
+					{
+						if (request->m_callback)
+							request->m_callback(nullptr, utile::web_error(std::error_code(ENOTCONN, std::generic_category()), "Failed to reconnect after pipeline was broken"));
+					}
+
+					m_pipeline.restart();
+					return;
+				}
+
+				// the server may not support pipelining at all, don't make the same mistake twice
+				m_pipeline.set_max_depth(1);
+				m_pipeline.restart(std::move(retried));
+				});
+		}
 	};
 } // namespace net
\ No newline at end of file
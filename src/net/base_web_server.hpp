@@ -9,10 +9,13 @@
 #include <system_error>
 #include <optional>
 #include <functional>
+#include <type_traits>
 
 #include "../utile/thread_safe_queue.hpp"
 
 #include "http_request.hpp"
+#include "listener_options.hpp"
+#include "response_compression.hpp"
 #include "web_message_controller.hpp"
 #include "../utile/data_types.hpp"
 #include "../utile/generic_error.hpp"
@@ -27,41 +30,44 @@ namespace net
 	class base_web_server
 	{
 	public:
+		// tcp for web_server/secure_web_server, local::stream_protocol for local_web_server
+		typedef typename T::lowest_layer_type::protocol_type protocol_type;
+		// takes over an accepted connection together with the id reserved for it
+		typedef std::function<void(std::shared_ptr<T>, const uint64_t)> connection_handle;
+
 		// can throw if invalid IP_ADRESS is present
-		base_web_server(const utile::IP_ADRESS& host, const utile::PORT port, const uint64_t max_nr_connections, const uint64_t number_threads) : m_idle_work(m_context), m_connection_accepter(m_context)
+		base_web_server(const utile::IP_ADRESS& host, const utile::PORT port, const uint64_t max_nr_connections, const uint64_t number_threads, const listener_options& options = listener_options()) :
+			base_web_server(build_endpoint(host, port), max_nr_connections, number_threads, options)
+		{
+		}
+
+		base_web_server(const typename protocol_type::endpoint& endpoint, const uint64_t max_nr_connections, const uint64_t number_threads, const listener_options& options = listener_options()) : 
+			m_idle_work(m_context), m_endpoint(endpoint), m_connection_accepter(m_context), m_listener_options(options)
 		{
 			assert(max_nr_connections > 0);
 			assert(number_threads > 0);
 
-			m_client_connection_handle = std::bind(&base_web_server::handle_client_connection, this, std::placeholders::_1);
+			m_client_connection_handle = std::bind(&base_web_server::handle_client_connection, this, std::placeholders::_1, std::placeholders::_2);
 
 			for (uint64_t it = 0; it < max_nr_connections; it++)
 				m_available_connection_ids.push_unsafe(it);
 
-			try
-			{
-				m_endpoint = boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(host), port);
-			}
-			catch (...)
-			{
-				throw std::runtime_error("Invalid host name provided: " + host);
-			}
-
-			for (int i = 0; i < number_threads; i++)
-			{
-				m_worker_threads.create_thread(boost::bind(&base_web_server::worker_function, this));
-			}
+			start_worker_threads(number_threads);
 		}
 
 		virtual ~base_web_server()
 		{
 			stop();
 
+			// a server that never started still has its workers waiting
+			m_context.stop();
 			m_worker_threads.join_all();
 		}
 
 		utile::web_error start()
 		{
+			restart_worker_threads();
+
 			{
 				std::scoped_lock lock(m_mutex);
 
@@ -70,14 +76,24 @@ namespace net
 					return utile::web_error();
 				}
 
+				on_server_start();
+
 				try
 				{
 					m_connection_accepter.open(m_endpoint.protocol());
 					m_connection_accepter.bind(m_endpoint);
-					m_connection_accepter.listen();
+					set_listener_socket_options();
+					m_connection_accepter.listen(m_listener_options.m_backlog);
+
+					// needed for draining pending connections without blocking, async_accept is not affected
+					m_connection_accepter.non_blocking(true);
 				}
 				catch (const std::exception& err)
 				{
+					// a half set up acceptor would pass for a running server on the next start()
+					boost::system::error_code ignored;
+					m_connection_accepter.close(ignored);
+
 					return utile::web_error(std::error_code(5, std::generic_category()), "Server exception: " + std::string(err.what()));
 				}
 			}
@@ -103,6 +119,8 @@ namespace net
 				disconnect(controller);
 			}
 
+			on_server_stop();
+
 			if (!m_context.stopped())
 				m_context.stop();
 
@@ -134,6 +152,36 @@ namespace net
 		{
 			m_mappings[type].erase(method);
 		}
+
+		// takes effect on the next start()
+		void set_listener_options(const listener_options& options)
+		{
+			std::scoped_lock lock(m_mutex);
+			m_listener_options = options;
+		}
+
+		// handler responses are compressed for clients whose Accept-Encoding allows it, has to be set before start()
+		void enable_response_compression(const compression_options& options = compression_options())
+		{
+			m_response_compression = options;
+		}
+
+		void disable_response_compression()
+		{
+			m_response_compression = std::nullopt;
+		}
+
+		// gzip and deflate request bodies are inflated before the handler sees them,
+		// a body that would inflate past the limits gets a 413 as soon as it crosses them
+		void enable_request_decompression(const utile::gzip::decompression_limits& limits)
+		{
+			m_request_decompression = limits;
+		}
+
+		void disable_request_decompression()
+		{
+			m_request_decompression = std::nullopt;
+		}
 	protected:
 		virtual bool can_client_connect(const std::shared_ptr<T> client) noexcept
 		{
@@ -146,20 +194,91 @@ namespace net
 		virtual void on_client_disconnect(const std::shared_ptr<T> client) noexcept
 		{
 #ifdef DEBUG
-			std::cout << "Client with ip: \"" << client->lowest_layer().remote_endpoint().address().to_string() << "\" disconnected\n";
+			if constexpr (std::is_same_v<protocol_type, boost::asio::ip::tcp>)
+			{
+				std::cout << "Client with ip: \"" << client->lowest_layer().remote_endpoint().address().to_string() << "\" disconnected\n";
+			}
 #endif
+		}
+		// called by start() right before the listener is bound
+		virtual void on_server_start() noexcept
+		{
+
+		}
+		// connections not handled by a web_message_controller have to be closed here
+		virtual void on_server_stop() noexcept
+		{
+
 		}
 		void set_build_client_socket_function(const std::function<std::shared_ptr<T>(boost::asio::io_context&)>& build_function) noexcept
 		{
 			m_build_client_socket_function = build_function;
 		}
 
-		void set_handshake_function(const std::function<void(std::shared_ptr<T>, std::function<void(std::shared_ptr<T>)>)>& handshake_function) noexcept
+		// the handshake has to hand the id on to the callback, or release it when the connection is dropped
+		void set_handshake_function(const std::function<void(std::shared_ptr<T>, const uint64_t, connection_handle)>& handshake_function) noexcept
 		{
 			m_handshake_function = handshake_function;
 		}
+
+		// every connection holds one of max_nr_connections ids while it is open
+		std::optional<uint64_t> reserve_connection_id()
+		{
+			return m_available_connection_ids.pop();
+		}
+
+		void release_connection_id(const uint64_t id)
+		{
+			m_available_connection_ids.push(id);
+		}
+
+		// runs the handler mapped to the request, nullopt when none matches
+		std::optional<http_response> route_request(std::shared_ptr<http_request> req)
+		{
+			auto method = req->get_method();
+			auto type = req->get_type();
+
+			std::smatch matches;
+			std::optional<http_response> reply = std::nullopt;
+
+			if (m_request_decompression != std::nullopt)
+			{
+				if (auto err = req->decompress_body(*m_request_decompression); !err)
+				{
+					return err.value() == utile::gzip::LIMIT_EXCEEDED ? http_response(413, "Content Too Large") : http_response(400, "Bad Request");
+				}
+			}
+
+			if (auto handle = find_apropriate_handle(type, method); handle != std::nullopt)
+			{
+				reply = ((*handle)->second)(req);
+			}
+			else if (auto reqex_handle = find_apropriate_regex_handle(type, method, matches); reqex_handle != std::nullopt)
+			{
+				reply = ((*reqex_handle)->second)(req, matches);
+			}
+
+			if (reply != std::nullopt && m_response_compression != std::nullopt)
+			{
+				compress_response(*req, *reply, *m_response_compression);
+			}
+
+			return reply;
+		}
 	private:
 
+		static typename protocol_type::endpoint build_endpoint(const utile::IP_ADRESS& host, const utile::PORT port)
+		{
+			try
+			{
+				return boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(host), port);
+			}
+			catch (...)
+			{
+				throw std::runtime_error("Invalid host name provided: " + host);
+			}
+		}
+
 		void wait_for_client_connection() noexcept
 		{
 			std::scoped_lock lock(m_mutex);
@@ -173,16 +292,16 @@ namespace net
 					{
 						if (!errcode)
 						{
-#ifdef DEBUG
-							std::cout << "Connection attempt from " << client_socket->lowest_layer().remote_endpoint() << std::endl;
-#endif
-							if (m_handshake_function)
+							// the id is taken as the connection is accepted, connections still in their handshake hold one as well
+							if (auto id = reserve_connection_id(); id != std::nullopt)
 							{
-								m_handshake_function(client_socket, m_client_connection_handle);
+								on_connection_accepted(client_socket, *id);
+								accept_pending_connections();
 							}
 							else
 							{
-								m_client_connection_handle(client_socket);
+								boost::system::error_code ignored;
+								client_socket->lowest_layer().close(ignored);
 							}
 						}
 						else
@@ -201,20 +320,117 @@ namespace net
 			}
 		}
 
-		void handle_client_connection(std::shared_ptr<T> client_socket)
+		// accepts connections already waiting in the backlog without going through the reactor again
+		void accept_pending_connections() noexcept
 		{
-			if (can_client_connect(client_socket))
+			for (uint32_t it = 1; it < m_listener_options.m_max_accepts_per_wakeup; it++)
 			{
-				auto id = m_available_connection_ids.pop();
+				auto id = reserve_connection_id();
 
 				if (id == std::nullopt)
 				{
-					std::cerr << "Internal error";
 					return;
 				}
 
-				auto client_id = id.value();
+				std::shared_ptr<T> client_socket;
+				boost::system::error_code errcode;
+
+				{
+					std::scoped_lock lock(m_mutex);
+
+					if (m_connection_accepter.is_open())
+					{
+						client_socket = m_build_client_socket_function(m_context);
+						m_connection_accepter.accept(client_socket->lowest_layer(), errcode);
+					}
+				}
+
+				// closed or would_block, backlog is empty
+				if (client_socket == nullptr || errcode)
+				{
+					release_connection_id(*id);
+					return;
+				}
+
+				on_connection_accepted(client_socket, *id);
+			}
+		}
+
+		void on_connection_accepted(std::shared_ptr<T> client_socket, const uint64_t client_id) noexcept
+		{
+#ifdef DEBUG
+			std::cout << "Connection attempt from " << client_socket->lowest_layer().remote_endpoint() << std::endl;
+#endif
+			set_client_socket_options(client_socket);
+
+			if (m_handshake_function)
+			{
+				m_handshake_function(client_socket, client_id, m_client_connection_handle);
+			}
+			else
+			{
+				m_client_connection_handle(client_socket, client_id);
+			}
+		}
+
+		void set_listener_socket_options()
+		{
+			if constexpr (!std::is_same_v<protocol_type, boost::asio::ip::tcp>)
+			{
+				return;
+			}
+
+			boost::system::error_code errcode;
+
+#if defined(__linux__) && defined(TCP_DEFER_ACCEPT)
+			if (m_listener_options.m_defer_accept_timeout != 0)
+			{
+				typedef boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_DEFER_ACCEPT> defer_accept;
+
+				if (m_connection_accepter.set_option(defer_accept(m_listener_options.m_defer_accept_timeout), errcode); errcode)
+				{
+					std::cerr << "Failed to set TCP_DEFER_ACCEPT err: " << errcode.message() << std::endl;
+				}
+			}
+#endif
+
+#ifdef TCP_FASTOPEN
+			if (m_listener_options.m_fast_open_queue_length != 0)
+			{
+				typedef boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_FASTOPEN> fast_open;
 
+				if (m_connection_accepter.set_option(fast_open(m_listener_options.m_fast_open_queue_length), errcode); errcode)
+				{
+					std::cerr << "Failed to set TCP_FASTOPEN err: " << errcode.message() << std::endl;
+				}
+			}
+#endif
+		}
+
+		void set_client_socket_options(std::shared_ptr<T>& client_socket) noexcept
+		{
+			// failing to tune an accepted socket is not a reason to drop the connection
+			boost::system::error_code errcode;
+
+			auto& socket = client_socket->lowest_layer();
+
+			if constexpr (std::is_same_v<protocol_type, boost::asio::ip::tcp>)
+			{
+				if (m_listener_options.m_no_delay)
+					socket.set_option(boost::asio::ip::tcp::no_delay(true), errcode);
+			}
+
+			if (m_listener_options.m_receive_buffer_size)
+				socket.set_option(boost::asio::socket_base::receive_buffer_size(*m_listener_options.m_receive_buffer_size), errcode);
+
+			if (m_listener_options.m_send_buffer_size)
+				socket.set_option(boost::asio::socket_base::send_buffer_size(*m_listener_options.m_send_buffer_size), errcode);
+		}
+
+		void handle_client_connection(std::shared_ptr<T> client_socket, const uint64_t client_id)
+		{
+			if (can_client_connect(client_socket))
+			{
 				async_get_callback get_callback = std::bind(&base_web_server::on_message_async, this, client_id, std::placeholders::_1, std::placeholders::_2);
 				async_send_callback send_callback = [this, client_id](utile::web_error err) {
 					if (!err)
@@ -223,7 +439,7 @@ namespace net
 						{
 							disconnect(it->second);
 							m_clients_controllers.erase(it);
-							m_available_connection_ids.push(client_id);
+							release_connection_id(client_id);
 						}
 						return;
 					}
@@ -245,6 +461,7 @@ namespace net
 				if (auto ret = m_clients_controllers.emplace(client_id, client_socket); !ret.second)
 				{
 					std::cerr << "Internal error";
+					release_connection_id(client_id);
 					return;
 				}
 				else
@@ -259,6 +476,7 @@ namespace net
 #ifdef DEBUG
 				std::cout << "Connection has been denied\n";
 #endif
+				release_connection_id(client_id);
 			}
 		}
 
@@ -279,7 +497,7 @@ namespace net
 					m_controllers_callbacks[client_id] = empty_callback_pair;
 					disconnect(it->second);
 					m_clients_controllers.erase(it);
-					m_available_connection_ids.push(client_id);
+					release_connection_id(client_id);
 				}
 				return;
 			}
@@ -292,26 +510,13 @@ namespace net
 				return;
 			}
 
-			auto method = req->get_method();
-			auto type = req->get_type();
-
 			if (auto it = m_clients_controllers.find(client_id); it != m_clients_controllers.end())
 			{
 				if (auto it2 = m_controllers_callbacks.find(client_id); it2 != m_controllers_callbacks.end())
 				{
-					std::smatch matches;
-
-					if (auto handle = find_apropriate_handle(type, method); handle != std::nullopt)
+					if (auto reply = route_request(req); reply != std::nullopt)
 					{
-						auto reply = ((*handle)->second)(req);
-
-						it->second.reply_async(std::move(reply), it2->second.second);
-					}
-					else if (auto reqex_handle = find_apropriate_regex_handle(type, method, matches); reqex_handle != std::nullopt)
-					{
-						auto reply = ((*reqex_handle)->second)(req, matches);
-
-						it->second.reply_async(std::move(reply), it2->second.second);
+						it->second.reply_async(std::move(*reply), it2->second.second);
 					}
 					else
 					{
@@ -348,6 +553,31 @@ namespace net
 			m_context.run();
 		}
 
+		void start_worker_threads(const uint64_t number_threads)
+		{
+			m_nr_worker_threads = number_threads;
+
+			for (uint64_t i = 0; i < number_threads; i++)
+			{
+				m_worker_threads.create_thread(boost::bind(&base_web_server::worker_function, this));
+			}
+		}
+
+		// stop() leaves the workers run out, they are joined outside m_mutex since their last handlers may still wait for it
+		void restart_worker_threads()
+		{
+			std::scoped_lock lock(m_restart_mutex);
+
+			if (!m_context.stopped())
+			{
+				return;
+			}
+
+			m_worker_threads.join_all();
+			m_context.restart();
+			start_worker_threads(m_nr_worker_threads);
+		}
+
 		std::optional<std::map<std::string, async_req_handle_callback>::iterator> find_apropriate_handle(const request_type type, const std::string& method)
 		{
 			auto& mapping = m_mappings[type];
@@ -376,17 +606,22 @@ namespace net
 
 		boost::asio::io_context m_context;
 		boost::asio::io_context::work m_idle_work;
-		boost::asio::ip::tcp::endpoint m_endpoint;
-		boost::asio::ip::tcp::acceptor m_connection_accepter;
+		typename protocol_type::endpoint m_endpoint;
+		typename protocol_type::acceptor m_connection_accepter;
+		listener_options m_listener_options;
+		std::optional<compression_options> m_response_compression = std::nullopt;
+		std::optional<utile::gzip::decompression_limits> m_request_decompression = std::nullopt;
 		std::mutex m_mutex;
+		std::mutex m_restart_mutex;
 		boost::thread_group m_worker_threads;
+		uint64_t m_nr_worker_threads = 0;
 		utile::thread_safe_queue<uint64_t> m_available_connection_ids;
 		std::map<request_type, std::map<std::string, async_req_handle_callback>> m_mappings;
 		std::map<request_type, std::vector<std::pair<std::regex, async_req_regex_handle_callback>>> m_regex_mappings;
 		std::map<uint64_t, web_message_controller<T>> m_clients_controllers;
 		std::map<uint64_t, std::pair<async_get_callback, async_send_callback>> m_controllers_callbacks;
-		std::function<void(std::shared_ptr<T>)> m_client_connection_handle;
+		connection_handle m_client_connection_handle;
 		std::function<std::shared_ptr<T>(boost::asio::io_context&)> m_build_client_socket_function = nullptr;
-		std::function<void(std::shared_ptr<T>, std::function<void(std::shared_ptr<T>)>)> m_handshake_function = nullptr;
+		std::function<void(std::shared_ptr<T>, const uint64_t, connection_handle)> m_handshake_function = nullptr;
 	};
 }
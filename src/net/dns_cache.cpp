@@ -0,0 +1,214 @@
+#include "dns_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace net
+{
+	namespace
+	{
+		std::string build_key(const std::string& host, const std::string& port)
+		{
+			return host + ":" + port;
+		}
+
+		std::optional<utile::PORT> service_to_port(const std::string& service) try
+		{
+			if (service == "http")
+				return 80;
+
+			if (service == "https")
+				return 443;
+
+			return static_cast<utile::PORT>(std::stoul(service));
+		}
+		catch (...)
+		{
+			return std::nullopt;
+		}
+
+		utile::web_error to_web_error(const boost::system::error_code& errcode)
+		{
+			return utile::web_error(std::error_code(errcode.value(), std::generic_category()), "Failed to resolve host err: " + errcode.message());
+		}
+	}
+
+	dns_cache& dns_cache::get_instance()
+	{
+		static dns_cache instance;
+		return instance;
+	}
+
+	void dns_cache::set_ttl(const std::chrono::seconds ttl, const std::chrono::seconds negative_ttl)
+	{
+		std::scoped_lock lock(m_mutex);
+		m_ttl = ttl;
+		m_negative_ttl = negative_ttl;
+	}
+
+	void dns_cache::set_max_entries(const size_t max_entries)
+	{
+		assert(max_entries > 0);
+
+		std::scoped_lock lock(m_mutex);
+		m_max_entries = max_entries;
+	}
+
+	void dns_cache::add_static_host(const std::string& host, const std::vector<boost::asio::ip::address>& addresses)
+	{
+		std::scoped_lock lock(m_mutex);
+		m_static_hosts[host] = addresses;
+	}
+
+	void dns_cache::remove_static_host(const std::string& host)
+	{
+		std::scoped_lock lock(m_mutex);
+		m_static_hosts.erase(host);
+	}
+
+	void dns_cache::invalidate(const std::string& host, const std::string& port)
+	{
+		std::scoped_lock lock(m_mutex);
+		m_entries.erase(build_key(host, port));
+	}
+
+	void dns_cache::clear()
+	{
+		std::scoped_lock lock(m_mutex);
+		m_entries.clear();
+	}
+
+	std::vector<boost::asio::ip::tcp::endpoint> dns_cache::resolve(boost::asio::ip::tcp::resolver& resolver, const std::string& host, const std::string& port, utile::web_error& err) noexcept
+	{
+		if (auto entry = lookup(host, port); entry != std::nullopt)
+		{
+			err = entry->m_error;
+			return entry->m_endpoints;
+		}
+
+		boost::system::error_code errcode;
+		auto results = resolver.resolve(host, port, errcode);
+
+		std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+
+		if (errcode)
+		{
+			err = to_web_error(errcode);
+		}
+		else
+		{
+			for (const auto& result : results)
+				endpoints.push_back(result.endpoint());
+
+			err = utile::web_error();
+		}
+
+		store(host, port, endpoints, err);
+
+		return endpoints;
+	}
+
+	void dns_cache::async_resolve(boost::asio::ip::tcp::resolver& resolver, const std::string& host, const std::string& port, const async_resolve_callback& callback) noexcept
+	{
+		if (auto entry = lookup(host, port); entry != std::nullopt)
+		{
+			if (callback) callback(entry->m_endpoints, entry->m_error);
+			return;
+		}
+
+		resolver.async_resolve(host, port, [this, host, port, callback](const boost::system::error_code& errcode, boost::asio::ip::tcp::resolver::results_type results) {
+			std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+			utile::web_error err;
+
+			if (errcode)
+			{
+				err = to_web_error(errcode);
+			}
+			else
+			{
+				for (const auto& result : results)
+					endpoints.push_back(result.endpoint());
+			}
+
+			// a cancelled lookup says nothing about the host
+			if (errcode != boost::asio::error::operation_aborted)
+				store(host, port, endpoints, err);
+
+			if (callback) callback(endpoints, err);
+			});
+	}
+
+	std::optional<dns_cache::cache_entry> dns_cache::lookup(const std::string& host, const std::string& port)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		if (auto it = m_static_hosts.find(host); it != m_static_hosts.end())
+		{
+			cache_entry entry;
+
+			if (auto port_number = service_to_port(port); port_number != std::nullopt)
+			{
+				for (const auto& address : it->second)
+					entry.m_endpoints.emplace_back(address, *port_number);
+			}
+			else
+			{
+				entry.m_error = utile::web_error(std::error_code(EINVAL, std::generic_category()), "Unknown service for static host: " + port);
+			}
+
+			return entry;
+		}
+
+		if (auto it = m_entries.find(build_key(host, port)); it != m_entries.end())
+		{
+			if (it->second.m_expires_at > std::chrono::steady_clock::now())
+			{
+				return it->second;
+			}
+
+			m_entries.erase(it);
+		}
+
+		return std::nullopt;
+	}
+
+	void dns_cache::store(const std::string& host, const std::string& port, const std::vector<boost::asio::ip::tcp::endpoint>& endpoints, const utile::web_error& err)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		if (m_entries.size() >= m_max_entries)
+		{
+			remove_expired_entries();
+
+			// still full, make room by dropping the entry closest to expiring
+			if (m_entries.size() >= m_max_entries)
+			{
+				auto oldest = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& left, const auto& right) {
+					return left.second.m_expires_at < right.second.m_expires_at;
+					});
+
+				m_entries.erase(oldest);
+			}
+		}
+
+		cache_entry entry;
+		entry.m_endpoints = endpoints;
+		entry.m_error = err;
+		entry.m_expires_at = std::chrono::steady_clock::now() + (err ? m_ttl : m_negative_ttl);
+
+		m_entries[build_key(host, port)] = entry;
+	}
+
+	void dns_cache::remove_expired_entries()
+	{
+		auto now = std::chrono::steady_clock::now();
+
+		for (auto it = m_entries.begin(); it != m_entries.end();)
+		{
+			if (it->second.m_expires_at <= now)
+				it = m_entries.erase(it);
+			else
+				it++;
+		}
+	}
+}
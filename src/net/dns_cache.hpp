@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "../utile/generic_error.hpp"
+#include "../utile/data_types.hpp"
+
+namespace net
+{
+	typedef std::function<void(std::vector<boost::asio::ip::tcp::endpoint>, utile::web_error)> async_resolve_callback;
+
+	// process wide resolution cache shared by all clients, successful lookups are kept for the ttl
+	// and failed ones for the negative ttl so reconnects and redirects don't go through the resolver again
+	class dns_cache
+	{
+	public:
+		static dns_cache& get_instance();
+
+		dns_cache(const dns_cache&) = delete;
+		dns_cache& operator=(const dns_cache&) = delete;
+
+		void set_ttl(const std::chrono::seconds ttl, const std::chrono::seconds negative_ttl);
+		void set_max_entries(const size_t max_entries);
+
+		// static entries are served before the cache and never expire, mostly useful for tests
+		void add_static_host(const std::string& host, const std::vector<boost::asio::ip::address>& addresses);
+		void remove_static_host(const std::string& host);
+
+		void invalidate(const std::string& host, const std::string& port);
+		void clear();
+
+		std::vector<boost::asio::ip::tcp::endpoint> resolve(boost::asio::ip::tcp::resolver& resolver, const std::string& host, const std::string& port, utile::web_error& err) noexcept;
+
+		// callback is invoked inline on a cache hit, otherwise on the resolver's executor
+		void async_resolve(boost::asio::ip::tcp::resolver& resolver, const std::string& host, const std::string& port, const async_resolve_callback& callback) noexcept;
+
+	private:
+		dns_cache() = default;
+
+		struct cache_entry
+		{
+			std::vector<boost::asio::ip::tcp::endpoint> m_endpoints;
+			utile::web_error m_error;
+			std::chrono::steady_clock::time_point m_expires_at;
+		};
+
+		std::optional<cache_entry> lookup(const std::string& host, const std::string& port);
+		void store(const std::string& host, const std::string& port, const std::vector<boost::asio::ip::tcp::endpoint>& endpoints, const utile::web_error& err);
+		void remove_expired_entries();
+
+		std::mutex m_mutex;
+		std::chrono::seconds m_ttl{ 60 };
+		std::chrono::seconds m_negative_ttl{ 5 };
+		size_t m_max_entries = 1024;
+		std::map<std::string, cache_entry> m_entries;
+		std::map<std::string, std::vector<boost::asio::ip::address>> m_static_hosts;
+	};
+}
@@ -0,0 +1,219 @@
+#include "endpoint_racer.hpp"
+
+#include <algorithm>
+
+namespace net
+{
+	namespace
+	{
+		constexpr size_t NO_WINNER = static_cast<size_t>(-1);
+	}
+
+	boost::system::error_code endpoint_racer::connect(boost::asio::basic_socket<boost::asio::ip::tcp>& socket, const std::vector<boost::asio::ip::tcp::endpoint>& endpoints, const std::chrono::milliseconds attempt_delay)
+	{
+		boost::asio::io_context io_context;
+		boost::system::error_code rez;
+
+		auto racer = std::make_shared<endpoint_racer>(io_context, endpoints, attempt_delay);
+
+		racer->start([&socket, &rez](const boost::system::error_code& error, boost::asio::ip::tcp::socket& winner, const boost::asio::ip::tcp::endpoint& endpoint) {
+			rez = error;
+
+			if (!error)
+			{
+				// the winner belongs to the private io_context, only its descriptor is handed over
+				socket.assign(endpoint.protocol(), winner.release(), rez);
+			}
+			});
+
+		io_context.run();
+
+		return rez;
+	}
+
+	std::shared_ptr<endpoint_racer> endpoint_racer::async_connect(boost::asio::basic_socket<boost::asio::ip::tcp>& socket, const std::vector<boost::asio::ip::tcp::endpoint>& endpoints,
+		const race_callback& callback, const std::chrono::milliseconds attempt_delay)
+	{
+		auto& io_context = static_cast<boost::asio::io_context&>(socket.get_executor().context());
+
+		auto racer = std::make_shared<endpoint_racer>(io_context, endpoints, attempt_delay);
+
+		racer->start([&socket, callback](const boost::system::error_code& error, boost::asio::ip::tcp::socket& winner, const boost::asio::ip::tcp::endpoint& endpoint) {
+			auto rez = error;
+
+			if (!error)
+			{
+				socket.assign(endpoint.protocol(), winner.release(), rez);
+			}
+
+			if (callback)
+				callback(rez, endpoint);
+			});
+
+		return racer;
+	}
+
+	std::vector<boost::asio::ip::tcp::endpoint> endpoint_racer::interleave(const std::vector<boost::asio::ip::tcp::endpoint>& endpoints)
+	{
+		if (endpoints.empty())
+		{
+			return endpoints;
+		}
+
+		std::vector<boost::asio::ip::tcp::endpoint> v6;
+		std::vector<boost::asio::ip::tcp::endpoint> v4;
+
+		for (const auto& endpoint : endpoints)
+		{
+			(endpoint.address().is_v6() ? v6 : v4).push_back(endpoint);
+		}
+
+		// the resolver already ordered them by preference, its first family goes first
+		auto& first = endpoints.front().address().is_v6() ? v6 : v4;
+		auto& second = endpoints.front().address().is_v6() ? v4 : v6;
+
+		std::vector<boost::asio::ip::tcp::endpoint> rez;
+		rez.reserve(endpoints.size());
+
+		for (size_t it = 0; it < std::max(first.size(), second.size()); it++)
+		{
+			if (it < first.size())
+				rez.push_back(first[it]);
+
+			if (it < second.size())
+				rez.push_back(second[it]);
+		}
+
+		return rez;
+	}
+
+	endpoint_racer::endpoint_racer(boost::asio::io_context& io_context, const std::vector<boost::asio::ip::tcp::endpoint>& endpoints, const std::chrono::milliseconds attempt_delay)
+		: m_io_context(io_context)
+		, m_endpoints(interleave(endpoints))
+		, m_sockets(m_endpoints.size())
+		, m_attempt_timer(io_context)
+		, m_attempt_delay(attempt_delay)
+	{
+	}
+
+	void endpoint_racer::start(const std::function<void(const boost::system::error_code&, boost::asio::ip::tcp::socket&, const boost::asio::ip::tcp::endpoint&)>& callback)
+	{
+		m_callback = callback;
+
+		if (m_endpoints.empty())
+		{
+			finish(boost::asio::error::host_not_found, NO_WINNER);
+			return;
+		}
+
+		start_next_attempt();
+	}
+
+	void endpoint_racer::cancel()
+	{
+		if (m_finished)
+		{
+			return;
+		}
+
+		finish(boost::asio::error::operation_aborted, NO_WINNER);
+	}
+
+	void endpoint_racer::start_next_attempt()
+	{
+		if (m_finished || m_next >= m_endpoints.size())
+		{
+			return;
+		}
+
+		auto index = m_next++;
+		auto self = shared_from_this();
+
+		m_sockets[index] = std::make_unique<boost::asio::ip::tcp::socket>(m_io_context);
+		m_nr_pending++;
+
+		m_sockets[index]->async_connect(m_endpoints[index], [self, index](const boost::system::error_code& error) {
+			self->on_attempt_completed(index, error);
+			});
+
+		if (m_next < m_endpoints.size())
+		{
+			auto generation = ++m_timer_generation;
+
+			m_attempt_timer.expires_after(m_attempt_delay);
+			m_attempt_timer.async_wait([self, generation](const boost::system::error_code& error) {
+				// an expired wait might already be queued when a failed attempt started the next one early
+				if (error || self->m_finished || generation != self->m_timer_generation)
+				{
+					return;
+				}
+
+				self->start_next_attempt();
+				});
+		}
+	}
+
+	void endpoint_racer::on_attempt_completed(const size_t index, const boost::system::error_code& error)
+	{
+		m_nr_pending--;
+
+		if (m_finished)
+		{
+			return;
+		}
+
+		if (!error)
+		{
+			finish(error, index);
+			return;
+		}
+
+		m_last_error = error;
+
+		boost::system::error_code ignored;
+		m_sockets[index]->close(ignored);
+
+		if (m_next < m_endpoints.size())
+		{
+			// no point in waiting for the delay, the next one starts right away
+			start_next_attempt();
+			return;
+		}
+
+		if (m_nr_pending == 0)
+		{
+			finish(m_last_error, NO_WINNER);
+		}
+	}
+
+	void endpoint_racer::finish(const boost::system::error_code& error, const size_t index)
+	{
+		m_finished = true;
+		m_attempt_timer.cancel();
+
+		for (size_t it = 0; it < m_sockets.size(); it++)
+		{
+			if (it != index && m_sockets[it] != nullptr && m_sockets[it]->is_open())
+			{
+				boost::system::error_code ignored;
+				m_sockets[it]->close(ignored);
+			}
+		}
+
+		auto callback = std::move(m_callback);
+
+		if (!callback)
+		{
+			return;
+		}
+
+		if (index == NO_WINNER)
+		{
+			boost::asio::ip::tcp::socket unused(m_io_context);
+			callback(error, unused, boost::asio::ip::tcp::endpoint());
+			return;
+		}
+
+		callback(error, *m_sockets[index], m_endpoints[index]);
+	}
+}
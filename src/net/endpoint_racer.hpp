@@ -0,0 +1,58 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace net
+{
+	typedef std::function<void(const boost::system::error_code&, const boost::asio::ip::tcp::endpoint&)> race_callback;
+
+	// connects to the first endpoint that answers (happy eyeballs, RFC 8305): address families are interleaved and a new
+	// attempt starts every attempt_delay or as soon as the previous one failed, while the earlier ones keep going;
+	// a blackholed address only costs attempt_delay instead of a full tcp timeout
+	class endpoint_racer : public std::enable_shared_from_this<endpoint_racer>
+	{
+	public:
+		static constexpr std::chrono::milliseconds DEFAULT_ATTEMPT_DELAY{ 250 };
+
+		// blocks until connected or every endpoint failed, the attempts run on an io_context of their own
+		static boost::system::error_code connect(boost::asio::basic_socket<boost::asio::ip::tcp>& socket, const std::vector<boost::asio::ip::tcp::endpoint>& endpoints,
+			const std::chrono::milliseconds attempt_delay = DEFAULT_ATTEMPT_DELAY);
+
+		// the callback runs on the executor of socket, which has to be run by a single thread;
+		// cancel() on the returned racer stops every attempt still running
+		static std::shared_ptr<endpoint_racer> async_connect(boost::asio::basic_socket<boost::asio::ip::tcp>& socket, const std::vector<boost::asio::ip::tcp::endpoint>& endpoints,
+			const race_callback& callback, const std::chrono::milliseconds attempt_delay = DEFAULT_ATTEMPT_DELAY);
+
+		// alternates between IPv6 and IPv4 starting with the family of the first endpoint, order within a family is kept
+		static std::vector<boost::asio::ip::tcp::endpoint> interleave(const std::vector<boost::asio::ip::tcp::endpoint>& endpoints);
+
+		endpoint_racer(boost::asio::io_context& io_context, const std::vector<boost::asio::ip::tcp::endpoint>& endpoints, const std::chrono::milliseconds attempt_delay);
+
+		// the callback gets the winning socket, or the error of the last attempt if none succeeded
+		void start(const std::function<void(const boost::system::error_code&, boost::asio::ip::tcp::socket&, const boost::asio::ip::tcp::endpoint&)>& callback);
+		void cancel();
+
+	private:
+		void start_next_attempt();
+		void on_attempt_completed(const size_t index, const boost::system::error_code& error);
+		void finish(const boost::system::error_code& error, const size_t index);
+
+		boost::asio::io_context& m_io_context;
+		std::vector<boost::asio::ip::tcp::endpoint> m_endpoints;
+		std::vector<std::unique_ptr<boost::asio::ip::tcp::socket>> m_sockets;
+		boost::asio::steady_timer m_attempt_timer;
+		const std::chrono::milliseconds m_attempt_delay;
+		std::function<void(const boost::system::error_code&, boost::asio::ip::tcp::socket&, const boost::asio::ip::tcp::endpoint&)> m_callback;
+		size_t m_next = 0;
+		size_t m_nr_pending = 0;
+		uint64_t m_timer_generation = 0;
+		bool m_finished = false;
+		boost::system::error_code m_last_error = boost::asio::error::host_not_found;
+	};
+}
@@ -0,0 +1,619 @@
+#include "hpack.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+namespace net
+{
+	namespace
+	{
+		const std::pair<const char*, const char*> STATIC_TABLE[] = {
+			{ ":authority", "" },
+			{ ":method", "GET" },
+			{ ":method", "POST" },
+			{ ":path", "/" },
+			{ ":path", "/index.html" },
+			{ ":scheme", "http" },
+			{ ":scheme", "https" },
+			{ ":status", "200" },
+			{ ":status", "204" },
+			{ ":status", "206" },
+			{ ":status", "304" },
+			{ ":status", "400" },
+			{ ":status", "404" },
+			{ ":status", "500" },
+			{ "accept-charset", "" },
+			{ "accept-encoding", "gzip, deflate" },
+			{ "accept-language", "" },
+			{ "accept-ranges", "" },
+			{ "accept", "" },
+			{ "access-control-allow-origin", "" },
+			{ "age", "" },
+			{ "allow", "" },
+			{ "authorization", "" },
+			{ "cache-control", "" },
+			{ "content-disposition", "" },
+			{ "content-encoding", "" },
+			{ "content-language", "" },
+			{ "content-length", "" },
+			{ "content-location", "" },
+			{ "content-range", "" },
+			{ "content-type", "" },
+			{ "cookie", "" },
+			{ "date", "" },
+			{ "etag", "" },
+			{ "expect", "" },
+			{ "expires", "" },
+			{ "from", "" },
+			{ "host", "" },
+			{ "if-match", "" },
+			{ "if-modified-since", "" },
+			{ "if-none-match", "" },
+			{ "if-range", "" },
+			{ "if-unmodified-since", "" },
+			{ "last-modified", "" },
+			{ "link", "" },
+			{ "location", "" },
+			{ "max-forwards", "" },
+			{ "proxy-authenticate", "" },
+			{ "proxy-authorization", "" },
+			{ "range", "" },
+			{ "referer", "" },
+			{ "refresh", "" },
+			{ "retry-after", "" },
+			{ "server", "" },
+			{ "set-cookie", "" },
+			{ "strict-transport-security", "" },
+			{ "transfer-encoding", "" },
+			{ "user-agent", "" },
+			{ "vary", "" },
+			{ "via", "" },
+			{ "www-authenticate", "" },
+		};
+
+		// rfc 7541 appendix b, the last entry is EOS
+		const uint32_t HUFFMAN_CODES[] = {
+			0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+			0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+			0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+			0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+			0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+			0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+			0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+			0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+			0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+			0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+			0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+			0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+			0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+			0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+			0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+			0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+			0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+			0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+			0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+			0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+			0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+			0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+			0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+			0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+			0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+			0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+			0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+			0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+			0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+			0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+			0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+			0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+			0x3fffffff,
+		};
+
+		const uint8_t HUFFMAN_CODE_LENGTHS[] = {
+			13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+			28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+			6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+			5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+			13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+			7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+			15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+			6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+			20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+			24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+			22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+			21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+			26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+			19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+			20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+			26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+			30,
+		};
+
+		constexpr size_t STATIC_TABLE_SIZE = sizeof(STATIC_TABLE) / sizeof(STATIC_TABLE[0]);
+		constexpr size_t EOS = 256;
+		// per entry overhead counted against the table size
+		constexpr size_t ENTRY_OVERHEAD = 32;
+
+		// fields that change with every response only churn the table
+		bool should_index(const std::string& name)
+		{
+			return name != "content-length" && name != "date" && name != "etag" && name != "set-cookie" && name != "authorization";
+		}
+
+		bool decode_integer(const uint8_t*& it, const uint8_t* end, const uint8_t prefix_bits, size_t& value)
+		{
+			if (it == end)
+			{
+				return false;
+			}
+
+			const uint8_t mask = static_cast<uint8_t>((1 << prefix_bits) - 1);
+
+			value = *it++ & mask;
+
+			if (value < mask)
+			{
+				return true;
+			}
+
+			for (size_t shift = 0; it != end; shift += 7)
+			{
+				// nothing sane needs more than 4 continuation bytes
+				if (shift > 28)
+				{
+					return false;
+				}
+
+				auto byte = *it++;
+				value += static_cast<size_t>(byte & 0x7f) << shift;
+
+				if ((byte & 0x80) == 0)
+				{
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void encode_integer(std::string& out, const uint8_t first_byte, const uint8_t prefix_bits, size_t value)
+		{
+			const size_t mask = (static_cast<size_t>(1) << prefix_bits) - 1;
+
+			if (value < mask)
+			{
+				out.push_back(static_cast<char>(first_byte | value));
+				return;
+			}
+
+			out.push_back(static_cast<char>(first_byte | mask));
+			value -= mask;
+
+			while (value >= 0x80)
+			{
+				out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+				value >>= 7;
+			}
+
+			out.push_back(static_cast<char>(value));
+		}
+
+		bool decode_string(const uint8_t*& it, const uint8_t* end, std::string& out)
+		{
+			if (it == end)
+			{
+				return false;
+			}
+
+			const bool huffman_encoded = (*it & 0x80) != 0;
+			size_t length = 0;
+
+			if (!decode_integer(it, end, 7, length) || length > static_cast<size_t>(end - it))
+			{
+				return false;
+			}
+
+			out.clear();
+
+			if (huffman_encoded)
+			{
+				if (!huffman::decode(it, length, out))
+				{
+					return false;
+				}
+			}
+			else
+			{
+				out.assign(reinterpret_cast<const char*>(it), length);
+			}
+
+			it += length;
+
+			return true;
+		}
+
+		void encode_string(std::string& out, const std::string& value)
+		{
+			if (auto size = huffman::get_encoded_size(value); size < value.size())
+			{
+				encode_integer(out, 0x80, 7, size);
+				huffman::encode(value, out);
+				return;
+			}
+
+			encode_integer(out, 0x00, 7, value.size());
+			out += value;
+		}
+
+		struct huffman_node
+		{
+			int32_t m_children[2] = { -1, -1 };
+			int32_t m_symbol = -1;
+		};
+
+		const std::vector<huffman_node>& get_huffman_tree()
+		{
+			static const std::vector<huffman_node> tree = []() {
+				std::vector<huffman_node> rez(1);
+
+				for (size_t symbol = 0; symbol <= EOS; symbol++)
+				{
+					size_t node = 0;
+
+					for (int bit = HUFFMAN_CODE_LENGTHS[symbol] - 1; bit >= 0; bit--)
+					{
+						auto branch = (HUFFMAN_CODES[symbol] >> bit) & 1;
+
+						if (rez[node].m_children[branch] == -1)
+						{
+							rez[node].m_children[branch] = static_cast<int32_t>(rez.size());
+							rez.emplace_back();
+						}
+
+						node = rez[node].m_children[branch];
+					}
+
+					rez[node].m_symbol = static_cast<int32_t>(symbol);
+				}
+
+				return rez;
+				}();
+
+			return tree;
+		}
+	}
+
+	hpack_table::hpack_table(const size_t max_size) : m_max_size(max_size)
+	{
+	}
+
+	const std::pair<std::string, std::string>* hpack_table::get(const size_t index) const noexcept
+	{
+		static const std::vector<std::pair<std::string, std::string>> static_entries(std::begin(STATIC_TABLE), std::end(STATIC_TABLE));
+
+		if (index == 0)
+		{
+			return nullptr;
+		}
+
+		if (index <= STATIC_TABLE_SIZE)
+		{
+			return &static_entries[index - 1];
+		}
+
+		if (index - STATIC_TABLE_SIZE > m_entries.size())
+		{
+			return nullptr;
+		}
+
+		return &m_entries[index - STATIC_TABLE_SIZE - 1];
+	}
+
+	std::optional<size_t> hpack_table::find(const std::string& name, const std::string& value, bool& value_matched) const noexcept
+	{
+		std::optional<size_t> rez = std::nullopt;
+		value_matched = false;
+
+		for (size_t it = 0; it < STATIC_TABLE_SIZE; it++)
+		{
+			if (name != STATIC_TABLE[it].first)
+				continue;
+
+			if (value == STATIC_TABLE[it].second)
+			{
+				value_matched = true;
+				return it + 1;
+			}
+
+			if (!rez)
+				rez = it + 1;
+		}
+
+		for (size_t it = 0; it < m_entries.size(); it++)
+		{
+			if (m_entries[it].first != name)
+				continue;
+
+			if (m_entries[it].second == value)
+			{
+				value_matched = true;
+				return STATIC_TABLE_SIZE + it + 1;
+			}
+
+			if (!rez)
+				rez = STATIC_TABLE_SIZE + it + 1;
+		}
+
+		return rez;
+	}
+
+	void hpack_table::add(const std::string& name, const std::string& value)
+	{
+		const size_t entry_size = name.size() + value.size() + ENTRY_OVERHEAD;
+
+		// an entry bigger than the whole table just empties it
+		if (entry_size > m_max_size)
+		{
+			m_entries.clear();
+			m_size = 0;
+			return;
+		}
+
+		evict(entry_size);
+
+		m_entries.emplace_front(name, value);
+		m_size += entry_size;
+	}
+
+	void hpack_table::set_max_size(const size_t max_size)
+	{
+		m_max_size = max_size;
+		evict(0);
+	}
+
+	size_t hpack_table::get_max_size() const noexcept
+	{
+		return m_max_size;
+	}
+
+	void hpack_table::evict(const size_t needed)
+	{
+		while (!m_entries.empty() && m_size + needed > m_max_size)
+		{
+			m_size -= m_entries.back().first.size() + m_entries.back().second.size() + ENTRY_OVERHEAD;
+			m_entries.pop_back();
+		}
+	}
+
+	hpack_decoder::hpack_decoder(const size_t max_table_size, const size_t max_header_list_size)
+		: m_table(max_table_size)
+		, m_max_table_size(max_table_size)
+		, m_max_header_list_size(max_header_list_size)
+	{
+	}
+
+	bool hpack_decoder::decode(const uint8_t* data, const size_t size, header_list& headers)
+	{
+		const uint8_t* it = data;
+		const uint8_t* end = data + size;
+		size_t list_size = 0;
+		std::string name;
+		std::string value;
+
+		while (it != end)
+		{
+			const uint8_t byte = *it;
+
+			if (byte & 0x80)
+			{
+				// indexed field
+				size_t index = 0;
+
+				if (!decode_integer(it, end, 7, index))
+				{
+					return false;
+				}
+
+				auto entry = m_table.get(index);
+
+				if (entry == nullptr)
+				{
+					return false;
+				}
+
+				name = entry->first;
+				value = entry->second;
+			}
+			else if ((byte & 0xe0) == 0x20)
+			{
+				// table size update, only allowed before the first field
+				size_t table_size = 0;
+
+				if (!headers.empty() || !decode_integer(it, end, 5, table_size) || table_size > m_max_table_size)
+				{
+					return false;
+				}
+
+				m_table.set_max_size(table_size);
+				continue;
+			}
+			else
+			{
+				// literal, with incremental indexing (01), never indexed (0001) or without indexing (0000)
+				const bool add_to_table = (byte & 0xc0) == 0x40;
+				size_t index = 0;
+
+				if (!decode_integer(it, end, add_to_table ? 6 : 4, index))
+				{
+					return false;
+				}
+
+				if (index != 0)
+				{
+					auto entry = m_table.get(index);
+
+					if (entry == nullptr)
+					{
+						return false;
+					}
+
+					name = entry->first;
+				}
+				else if (!decode_string(it, end, name))
+				{
+					return false;
+				}
+
+				if (!decode_string(it, end, value))
+				{
+					return false;
+				}
+
+				if (add_to_table)
+					m_table.add(name, value);
+			}
+
+			list_size += name.size() + value.size() + ENTRY_OVERHEAD;
+
+			if (list_size > m_max_header_list_size)
+			{
+				return false;
+			}
+
+			headers.emplace_back(std::move(name), std::move(value));
+		}
+
+		return true;
+	}
+
+	void hpack_encoder::set_max_table_size(const size_t max_table_size)
+	{
+		// never more than the default, the peer only allows us to use less
+		auto size = std::min<size_t>(max_table_size, 4096);
+
+		if (size != m_table.get_max_size())
+		{
+			m_table.set_max_size(size);
+			m_pending_size_update = size;
+		}
+	}
+
+	void hpack_encoder::encode(const header_list& headers, std::string& out)
+	{
+		if (m_pending_size_update)
+		{
+			encode_integer(out, 0x20, 5, *m_pending_size_update);
+			m_pending_size_update = std::nullopt;
+		}
+
+		for (const auto& [name, value] : headers)
+		{
+			bool value_matched = false;
+			auto index = m_table.find(name, value, value_matched);
+
+			if (index && value_matched)
+			{
+				encode_integer(out, 0x80, 7, *index);
+				continue;
+			}
+
+			const bool add_to_table = should_index(name);
+
+			if (index)
+			{
+				encode_integer(out, add_to_table ? 0x40 : 0x00, add_to_table ? 6 : 4, *index);
+			}
+			else
+			{
+				out.push_back(add_to_table ? 0x40 : 0x00);
+				encode_string(out, name);
+			}
+
+			encode_string(out, value);
+
+			if (add_to_table)
+				m_table.add(name, value);
+		}
+	}
+
+	namespace huffman
+	{
+		bool decode(const uint8_t* data, const size_t size, std::string& out)
+		{
+			const auto& tree = get_huffman_tree();
+
+			size_t node = 0;
+			// bits read since the last symbol, what is left at the end has to be an EOS prefix (all ones) shorter than a byte
+			size_t nr_pending_bits = 0;
+			bool all_ones = true;
+
+			for (size_t it = 0; it < size; it++)
+			{
+				for (int bit = 7; bit >= 0; bit--)
+				{
+					auto branch = (data[it] >> bit) & 1;
+					auto next = tree[node].m_children[branch];
+
+					if (next == -1)
+					{
+						return false;
+					}
+
+					node = next;
+					nr_pending_bits++;
+					all_ones = all_ones && branch == 1;
+
+					if (tree[node].m_symbol != -1)
+					{
+						if (tree[node].m_symbol == EOS)
+						{
+							return false;
+						}
+
+						out.push_back(static_cast<char>(tree[node].m_symbol));
+						node = 0;
+						nr_pending_bits = 0;
+						all_ones = true;
+					}
+				}
+			}
+
+			return nr_pending_bits < 8 && all_ones;
+		}
+
+		void encode(const std::string& data, std::string& out)
+		{
+			uint64_t bits = 0;
+			size_t nr_bits = 0;
+
+			for (unsigned char symbol : data)
+			{
+				bits = (bits << HUFFMAN_CODE_LENGTHS[symbol]) | HUFFMAN_CODES[symbol];
+				nr_bits += HUFFMAN_CODE_LENGTHS[symbol];
+
+				while (nr_bits >= 8)
+				{
+					nr_bits -= 8;
+					out.push_back(static_cast<char>(bits >> nr_bits));
+				}
+			}
+
+			// padded with the most significant bits of EOS
+			if (nr_bits > 0)
+			{
+				out.push_back(static_cast<char>((bits << (8 - nr_bits)) | (0xff >> nr_bits)));
+			}
+		}
+
+		size_t get_encoded_size(const std::string& data) noexcept
+		{
+			size_t nr_bits = 0;
+
+			for (unsigned char symbol : data)
+			{
+				nr_bits += HUFFMAN_CODE_LENGTHS[symbol];
+			}
+
+			return (nr_bits + 7) / 8;
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace net
+{
+	// header fields of an http/2 header block, names are lowercase
+	typedef std::vector<std::pair<std::string, std::string>> header_list;
+
+	// static and dynamic table shared by the encoder and decoder (rfc 7541)
+	class hpack_table
+	{
+	public:
+		hpack_table(const size_t max_size = 4096);
+
+		// 1 based, the dynamic entries follow the static ones
+		const std::pair<std::string, std::string>* get(const size_t index) const noexcept;
+		// index of an entry matching name and value, or only the name when the value differs
+		std::optional<size_t> find(const std::string& name, const std::string& value, bool& value_matched) const noexcept;
+
+		void add(const std::string& name, const std::string& value);
+		void set_max_size(const size_t max_size);
+		size_t get_max_size() const noexcept;
+
+	private:
+		void evict(const size_t needed);
+
+		// newest first
+		std::deque<std::pair<std::string, std::string>> m_entries;
+		size_t m_size = 0;
+		size_t m_max_size;
+	};
+
+	class hpack_decoder
+	{
+	public:
+		// max_header_list_size bounds the decoded size, a small block can reference big table entries over and over
+		hpack_decoder(const size_t max_table_size = 4096, const size_t max_header_list_size = 65536);
+
+		// false on a malformed block, the table can't be trusted anymore after that
+		bool decode(const uint8_t* data, const size_t size, header_list& headers);
+
+	private:
+		hpack_table m_table;
+		const size_t m_max_table_size;
+		const size_t m_max_header_list_size;
+	};
+
+	class hpack_encoder
+	{
+	public:
+		// max_table_size comes from the peer's SETTINGS_HEADER_TABLE_SIZE
+		void set_max_table_size(const size_t max_table_size);
+
+		void encode(const header_list& headers, std::string& out);
+
+	private:
+		hpack_table m_table;
+		// a size update has to start the next block
+		std::optional<size_t> m_pending_size_update = std::nullopt;
+	};
+
+	namespace huffman
+	{
+		bool decode(const uint8_t* data, const size_t size, std::string& out);
+		void encode(const std::string& data, std::string& out);
+		size_t get_encoded_size(const std::string& data) noexcept;
+	}
+}
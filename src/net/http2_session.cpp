@@ -0,0 +1,974 @@
+#include "http2_session.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace net
+{
+	namespace
+	{
+		const char CONNECTION_PREFACE[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+		constexpr size_t CONNECTION_PREFACE_SIZE = sizeof(CONNECTION_PREFACE) - 1;
+		constexpr size_t FRAME_HEADER_SIZE = 9;
+		constexpr size_t READ_BUFFER_SIZE = 65536;
+		constexpr int64_t DEFAULT_WINDOW_SIZE = 65535;
+		constexpr int64_t MAX_WINDOW_SIZE = 0x7fffffff;
+
+		enum frame_type : uint8_t
+		{
+			data_frame = 0x0,
+			headers_frame = 0x1,
+			priority_frame = 0x2,
+			rst_stream_frame = 0x3,
+			settings_frame = 0x4,
+			push_promise_frame = 0x5,
+			ping_frame = 0x6,
+			goaway_frame = 0x7,
+			window_update_frame = 0x8,
+			continuation_frame = 0x9
+		};
+
+		enum frame_flag : uint8_t
+		{
+			end_stream_flag = 0x1,
+			ack_flag = 0x1,
+			end_headers_flag = 0x4,
+			padded_flag = 0x8,
+			priority_flag = 0x20
+		};
+
+		enum error_code_type : uint32_t
+		{
+			no_error = 0x0,
+			protocol_error = 0x1,
+			flow_control_error = 0x3,
+			stream_closed_error = 0x5,
+			frame_size_error = 0x6,
+			refused_stream_error = 0x7,
+			compression_error = 0x9,
+			enhance_your_calm_error = 0xb
+		};
+
+		enum settings_id : uint16_t
+		{
+			header_table_size_setting = 0x1,
+			enable_push_setting = 0x2,
+			max_concurrent_streams_setting = 0x3,
+			initial_window_size_setting = 0x4,
+			max_frame_size_setting = 0x5,
+			max_header_list_size_setting = 0x6
+		};
+
+		uint32_t read_uint32(const uint8_t* data)
+		{
+			return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+		}
+
+		void append_uint32(std::string& out, const uint32_t value)
+		{
+			out.push_back(static_cast<char>(value >> 24));
+			out.push_back(static_cast<char>(value >> 16));
+			out.push_back(static_cast<char>(value >> 8));
+			out.push_back(static_cast<char>(value));
+		}
+
+		void append_setting(std::string& out, const uint16_t id, const uint32_t value)
+		{
+			out.push_back(static_cast<char>(id >> 8));
+			out.push_back(static_cast<char>(id));
+			append_uint32(out, value);
+		}
+
+		// only meaningful for a single http/1.1 connection
+		bool is_connection_header(const std::string& name)
+		{
+			return name == "connection" || name == "keep-alive" || name == "proxy-connection" || name == "transfer-encoding" || name == "upgrade";
+		}
+
+		// same value types the http/1.1 parser produces
+		nlohmann::json to_header_value(const std::string& value)
+		{
+			try
+			{
+				auto int_value = std::stoull(value);
+
+				if (std::to_string(int_value) == value)
+				{
+					return int_value;
+				}
+			}
+			catch (...)
+			{
+			}
+
+			return value;
+		}
+	}
+
+	http2_session::http2_session(std::shared_ptr<socket_type> socket, const http2_settings& settings, const request_handler& handler, const std::function<void()>& on_closed)
+		: m_socket(socket)
+		, m_strand(boost::asio::make_strand(socket->get_executor()))
+		, m_settings(settings)
+		, m_handler(handler)
+		, m_on_closed(on_closed)
+		, m_decoder(4096, settings.m_max_header_list_size)
+		, m_read_buffer(READ_BUFFER_SIZE)
+	{
+	}
+
+	void http2_session::start()
+	{
+		boost::asio::dispatch(m_strand, [self = shared_from_this()]() {
+			self->write_settings();
+
+			// the connection window can only be raised with a WINDOW_UPDATE
+			self->m_recv_window = DEFAULT_WINDOW_SIZE;
+
+			if (self->m_settings.m_connection_window_size > DEFAULT_WINDOW_SIZE)
+			{
+				self->write_window_update(0, static_cast<uint32_t>(self->m_settings.m_connection_window_size - DEFAULT_WINDOW_SIZE));
+				self->m_recv_window = self->m_settings.m_connection_window_size;
+			}
+
+			self->flush();
+			self->read();
+			});
+	}
+
+	void http2_session::close()
+	{
+		// the socket is only touched on the strand, the pending operations end with an error once it's closed
+		boost::asio::post(m_strand, [self = shared_from_this()]() {
+			self->close_connection();
+			});
+	}
+
+	void http2_session::read()
+	{
+		m_socket->async_read_some(boost::asio::buffer(m_read_buffer), boost::asio::bind_executor(m_strand,
+			[self = shared_from_this()](const boost::system::error_code& err, const size_t nr_bytes) {
+				self->on_read(err, nr_bytes);
+			}));
+	}
+
+	void http2_session::on_read(const boost::system::error_code& err, const size_t nr_bytes)
+	{
+		if (m_closed)
+		{
+			return;
+		}
+
+		if (err)
+		{
+			close_connection();
+			return;
+		}
+
+		m_input.insert(m_input.end(), m_read_buffer.begin(), m_read_buffer.begin() + nr_bytes);
+
+		if (!process_input())
+		{
+			return;
+		}
+
+		flush();
+		read();
+	}
+
+	bool http2_session::process_input()
+	{
+		size_t offset = 0;
+
+		if (!m_preface_received)
+		{
+			if (m_input.size() < CONNECTION_PREFACE_SIZE)
+			{
+				return true;
+			}
+
+			if (std::memcmp(m_input.data(), CONNECTION_PREFACE, CONNECTION_PREFACE_SIZE) != 0)
+			{
+				return fail(protocol_error);
+			}
+
+			m_preface_received = true;
+			offset = CONNECTION_PREFACE_SIZE;
+		}
+
+		while (m_input.size() - offset >= FRAME_HEADER_SIZE)
+		{
+			const uint8_t* header = m_input.data() + offset;
+			const uint32_t length = (static_cast<uint32_t>(header[0]) << 16) | (static_cast<uint32_t>(header[1]) << 8) | header[2];
+			const uint32_t stream_id = read_uint32(header + 5) & 0x7fffffff;
+
+			if (length > m_settings.m_max_frame_size)
+			{
+				return fail(frame_size_error);
+			}
+
+			if (m_input.size() - offset - FRAME_HEADER_SIZE < length)
+			{
+				break;
+			}
+
+			if (!process_frame(header[3], header[4], stream_id, header + FRAME_HEADER_SIZE, length))
+			{
+				return false;
+			}
+
+			// PINGs, SETTINGS or resets sent faster than their answers are read
+			if (m_output.size() > m_settings.m_max_queued_output)
+			{
+				return fail(enhance_your_calm_error);
+			}
+
+			offset += FRAME_HEADER_SIZE + length;
+		}
+
+		m_input.erase(m_input.begin(), m_input.begin() + offset);
+
+		return true;
+	}
+
+	bool http2_session::process_frame(const uint8_t type, const uint8_t flags, const uint32_t stream_id, const uint8_t* payload, const uint32_t length)
+	{
+		// nothing may come between a HEADERS frame and its CONTINUATIONs
+		if (m_header_stream_id != 0 && type != continuation_frame)
+		{
+			return fail(protocol_error);
+		}
+
+		switch (type)
+		{
+		case data_frame:
+			return on_data(flags, stream_id, payload, length);
+		case headers_frame:
+			return on_headers(flags, stream_id, payload, length);
+		case continuation_frame:
+			return on_continuation(flags, stream_id, payload, length);
+		case settings_frame:
+			return on_settings(flags, stream_id, payload, length);
+		case window_update_frame:
+			return on_window_update(stream_id, payload, length);
+		case rst_stream_frame:
+			return on_rst_stream(stream_id, length);
+		case ping_frame:
+			return on_ping(flags, stream_id, payload, length);
+		case push_promise_frame:
+			// clients can't push
+			return fail(protocol_error);
+		case goaway_frame:
+			// the client closes the connection once it has its responses
+			return stream_id == 0 || fail(protocol_error);
+		default:
+			// PRIORITY and unknown frames are ignored, every stream gets its turn
+			return true;
+		}
+	}
+
+	bool http2_session::on_headers(const uint8_t flags, const uint32_t stream_id, const uint8_t* payload, uint32_t length)
+	{
+		if (stream_id == 0 || stream_id % 2 == 0)
+		{
+			return fail(protocol_error);
+		}
+
+		uint32_t offset = 0;
+
+		if (flags & padded_flag)
+		{
+			if (length < 1 || payload[0] >= length)
+			{
+				return fail(protocol_error);
+			}
+
+			length -= payload[0];
+			offset = 1;
+		}
+
+		if (flags & priority_flag)
+		{
+			if (length < offset + 5)
+			{
+				return fail(frame_size_error);
+			}
+
+			offset += 5;
+		}
+
+		m_header_block.assign(reinterpret_cast<const char*>(payload + offset), length - offset);
+		m_header_stream_id = stream_id;
+		m_header_end_stream = (flags & end_stream_flag) != 0;
+
+		if (flags & end_headers_flag)
+		{
+			return on_header_block_completed();
+		}
+
+		return true;
+	}
+
+	bool http2_session::on_continuation(const uint8_t flags, const uint32_t stream_id, const uint8_t* payload, const uint32_t length)
+	{
+		if (m_header_stream_id == 0 || stream_id != m_header_stream_id)
+		{
+			return fail(protocol_error);
+		}
+
+		m_header_block.append(reinterpret_cast<const char*>(payload), length);
+
+		if (m_header_block.size() > m_settings.m_max_header_list_size)
+		{
+			return fail(enhance_your_calm_error);
+		}
+
+		if (flags & end_headers_flag)
+		{
+			return on_header_block_completed();
+		}
+
+		return true;
+	}
+
+	bool http2_session::on_header_block_completed()
+	{
+		const auto stream_id = m_header_stream_id;
+		m_header_stream_id = 0;
+
+		// the block has to be decoded even for refused streams, the table would be out of sync otherwise
+		header_list headers;
+
+		if (!m_decoder.decode(reinterpret_cast<const uint8_t*>(m_header_block.data()), m_header_block.size(), headers))
+		{
+			return fail(compression_error);
+		}
+
+		m_header_block.clear();
+
+		if (auto it = m_streams.find(stream_id); it != m_streams.end())
+		{
+			// trailers, they end the request
+			if (!m_header_end_stream || it->second.m_remote_closed)
+			{
+				reset_stream(stream_id, it->second.m_remote_closed ? stream_closed_error : protocol_error);
+				erase_stream(it);
+				return true;
+			}
+
+			it->second.m_remote_closed = true;
+			dispatch(stream_id, it->second);
+			return true;
+		}
+
+		if (stream_id <= m_last_stream_id)
+		{
+			return fail(stream_closed_error);
+		}
+
+		m_last_stream_id = stream_id;
+
+		// reset streams still count while their handlers run, resetting every request right away gains nothing
+		if (m_streams.size() + m_nr_orphaned_handlers >= m_settings.m_max_concurrent_streams)
+		{
+			reset_stream(stream_id, refused_stream_error);
+			return true;
+		}
+
+		auto& request_stream = m_streams[stream_id];
+
+		request_stream.m_headers = std::move(headers);
+		request_stream.m_send_window = m_peer_initial_window_size;
+		request_stream.m_recv_window = m_settings.m_initial_window_size;
+
+		if (m_header_end_stream)
+		{
+			request_stream.m_remote_closed = true;
+			dispatch(stream_id, request_stream);
+		}
+
+		return true;
+	}
+
+	bool http2_session::on_data(const uint8_t flags, const uint32_t stream_id, const uint8_t* payload, uint32_t length)
+	{
+		if (stream_id == 0)
+		{
+			return fail(protocol_error);
+		}
+
+		// padding counts against the windows as well
+		const uint32_t frame_length = length;
+		uint32_t offset = 0;
+
+		if (flags & padded_flag)
+		{
+			if (length < 1 || payload[0] >= length)
+			{
+				return fail(protocol_error);
+			}
+
+			length -= payload[0];
+			offset = 1;
+		}
+
+		m_recv_window -= frame_length;
+
+		if (m_recv_window < 0)
+		{
+			return fail(flow_control_error);
+		}
+
+		m_nr_unacked_bytes += frame_length;
+
+		if (m_nr_unacked_bytes >= m_settings.m_connection_window_size / 2)
+		{
+			write_window_update(0, m_nr_unacked_bytes);
+			m_recv_window += m_nr_unacked_bytes;
+			m_nr_unacked_bytes = 0;
+		}
+
+		auto it = m_streams.find(stream_id);
+
+		if (it == m_streams.end())
+		{
+			if (stream_id > m_last_stream_id)
+			{
+				return fail(protocol_error);
+			}
+
+			// reset or refused earlier, the client didn't know yet
+			reset_stream(stream_id, stream_closed_error);
+			return true;
+		}
+
+		if (it->second.m_remote_closed)
+		{
+			// the stream is reset, its response is dropped once the handler is done
+			reset_stream(stream_id, stream_closed_error);
+			erase_stream(it);
+			return true;
+		}
+
+		auto& request_stream = it->second;
+
+		request_stream.m_recv_window -= frame_length;
+
+		if (request_stream.m_recv_window < 0)
+		{
+			reset_stream(stream_id, flow_control_error);
+			erase_stream(it);
+			return true;
+		}
+
+		if (request_stream.m_body.size() + (length - offset) > m_settings.m_max_request_body_size)
+		{
+			// answered before the request is complete, the reset tells the client to stop sending
+			on_response(stream_id, http_response(413, "Content Too Large"));
+			reset_stream(stream_id, no_error);
+			return true;
+		}
+
+		request_stream.m_body.insert(request_stream.m_body.end(), payload + offset, payload + length);
+
+		if (flags & end_stream_flag)
+		{
+			request_stream.m_remote_closed = true;
+			dispatch(stream_id, request_stream);
+			return true;
+		}
+
+		request_stream.m_nr_unacked_bytes += frame_length;
+
+		if (request_stream.m_nr_unacked_bytes >= m_settings.m_initial_window_size / 2)
+		{
+			write_window_update(stream_id, request_stream.m_nr_unacked_bytes);
+			request_stream.m_recv_window += request_stream.m_nr_unacked_bytes;
+			request_stream.m_nr_unacked_bytes = 0;
+		}
+
+		return true;
+	}
+
+	bool http2_session::on_settings(const uint8_t flags, const uint32_t stream_id, const uint8_t* payload, const uint32_t length)
+	{
+		if (stream_id != 0)
+		{
+			return fail(protocol_error);
+		}
+
+		if (flags & ack_flag)
+		{
+			return length == 0 || fail(frame_size_error);
+		}
+
+		if (length % 6 != 0)
+		{
+			return fail(frame_size_error);
+		}
+
+		for (uint32_t it = 0; it < length; it += 6)
+		{
+			const uint16_t id = static_cast<uint16_t>((payload[it] << 8) | payload[it + 1]);
+			const uint32_t value = read_uint32(payload + it + 2);
+
+			switch (id)
+			{
+			case header_table_size_setting:
+				m_encoder.set_max_table_size(value);
+				break;
+			case enable_push_setting:
+				if (value > 1)
+					return fail(protocol_error);
+				break;
+			case initial_window_size_setting:
+				if (value > MAX_WINDOW_SIZE)
+					return fail(flow_control_error);
+
+				// applies to the streams already open as well
+				for (auto& [_, open_stream] : m_streams)
+				{
+					open_stream.m_send_window += static_cast<int64_t>(value) - m_peer_initial_window_size;
+				}
+
+				m_peer_initial_window_size = value;
+				break;
+			case max_frame_size_setting:
+				if (value < 16384 || value > 16777215)
+					return fail(protocol_error);
+
+				m_peer_max_frame_size = value;
+				break;
+			default:
+				break;
+			}
+		}
+
+		write_frame(settings_frame, ack_flag, 0, nullptr, 0);
+		send_pending_data();
+
+		return true;
+	}
+
+	bool http2_session::on_window_update(const uint32_t stream_id, const uint8_t* payload, const uint32_t length)
+	{
+		if (length != 4)
+		{
+			return fail(frame_size_error);
+		}
+
+		const uint32_t increment = read_uint32(payload) & 0x7fffffff;
+
+		if (stream_id == 0)
+		{
+			m_send_window += increment;
+
+			if (increment == 0 || m_send_window > MAX_WINDOW_SIZE)
+			{
+				return fail(increment == 0 ? protocol_error : flow_control_error);
+			}
+		}
+		else if (auto it = m_streams.find(stream_id); it != m_streams.end())
+		{
+			it->second.m_send_window += increment;
+
+			if (increment == 0 || it->second.m_send_window > MAX_WINDOW_SIZE)
+			{
+				reset_stream(stream_id, increment == 0 ? protocol_error : flow_control_error);
+				erase_stream(it);
+				return true;
+			}
+		}
+
+		send_pending_data();
+
+		return true;
+	}
+
+	bool http2_session::on_rst_stream(const uint32_t stream_id, const uint32_t length)
+	{
+		if (length != 4)
+		{
+			return fail(frame_size_error);
+		}
+
+		if (stream_id == 0)
+		{
+			return fail(protocol_error);
+		}
+
+		// a response still being built is dropped once it's done
+		if (auto it = m_streams.find(stream_id); it != m_streams.end())
+		{
+			erase_stream(it);
+		}
+
+		return true;
+	}
+
+	bool http2_session::on_ping(const uint8_t flags, const uint32_t stream_id, const uint8_t* payload, const uint32_t length)
+	{
+		if (length != 8)
+		{
+			return fail(frame_size_error);
+		}
+
+		if (stream_id != 0)
+		{
+			return fail(protocol_error);
+		}
+
+		if ((flags & ack_flag) == 0)
+		{
+			write_frame(ping_frame, ack_flag, 0, payload, length);
+		}
+
+		return true;
+	}
+
+	void http2_session::erase_stream(std::map<uint32_t, stream>::iterator it)
+	{
+		if (it->second.m_handling)
+		{
+			*it->second.m_reset = true;
+			m_nr_orphaned_handlers++;
+		}
+
+		m_streams.erase(it);
+	}
+
+	void http2_session::dispatch(const uint32_t stream_id, stream& request_stream)
+	{
+		auto request = build_request(request_stream);
+
+		if (request == nullptr)
+		{
+			on_response(stream_id, http_response(400, "Bad Request"));
+			return;
+		}
+
+		request_stream.m_head_request = request->get_type() == request_type::HEAD;
+		request_stream.m_handling = true;
+		request_stream.m_reset = std::make_shared<std::atomic<bool>>(false);
+
+		// the handlers run on the worker threads, the response comes back through the strand
+		boost::asio::post(m_socket->get_executor(), [self = shared_from_this(), stream_id, request, reset = request_stream.m_reset]() {
+			// reset while queued, nobody waits for the response anymore
+			auto response = *reset ? http_response() : self->m_handler(request);
+
+			boost::asio::post(self->m_strand, [self, stream_id, reset, response = std::move(response)]() mutable {
+				if (*reset)
+				{
+					self->m_nr_orphaned_handlers--;
+					return;
+				}
+
+				self->on_response(stream_id, std::move(response));
+				self->flush();
+				});
+			});
+	}
+
+	std::shared_ptr<http_request> http2_session::build_request(stream& request_stream)
+	{
+		std::string method{};
+		std::string path{};
+		std::string authority{};
+		std::map<std::string, std::string> fields;
+
+		for (const auto& [name, value] : request_stream.m_headers)
+		{
+			if (name == ":method")
+			{
+				method = value;
+			}
+			else if (name == ":path")
+			{
+				path = value;
+			}
+			else if (name == ":authority")
+			{
+				authority = value;
+			}
+			else if (!name.empty() && name[0] != ':')
+			{
+				// repeated fields are joined, cookies are split into several fields to compress better
+				auto [it, inserted] = fields.emplace(name, value);
+
+				if (!inserted)
+					it->second += (name == "cookie" ? "; " : ", ") + value;
+			}
+		}
+
+		if (method.empty() || path.empty())
+		{
+			return nullptr;
+		}
+
+		request_type type;
+
+		try
+		{
+			type = string_to_request_type(method);
+		}
+		catch (...)
+		{
+			return nullptr;
+		}
+
+		nlohmann::json header_data = nlohmann::json::object();
+
+		for (const auto& [name, value] : fields)
+		{
+			header_data[name] = to_header_value(value);
+		}
+
+		if (!authority.empty() && !header_data.contains("host"))
+		{
+			header_data["host"] = authority;
+		}
+
+		auto request = std::make_shared<http_request>(type, path, content_type::any, header_data, request_stream.m_body);
+
+		request->set_host(authority);
+		request_stream.m_headers.clear();
+		request_stream.m_body.clear();
+
+		return request;
+	}
+
+	void http2_session::on_response(const uint32_t stream_id, http_response&& response)
+	{
+		auto it = m_streams.find(stream_id);
+
+		// reset by the client in the meantime
+		if (m_closed || it == m_streams.end())
+		{
+			return;
+		}
+
+		auto& response_stream = it->second;
+		response_stream.m_handling = false;
+
+		header_list headers{ { ":status", std::to_string(response.get_status()) } };
+
+		if (auto header_data = response.get_header(); header_data.is_object())
+		{
+			for (const auto& item : header_data.items())
+			{
+				auto name = item.key();
+				std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+				if (is_connection_header(name))
+					continue;
+
+				if (item.value().is_number())
+				{
+					headers.emplace_back(name, std::to_string(item.value().get<long long>()));
+				}
+				else if (item.value().is_string())
+				{
+					headers.emplace_back(name, item.value().get<std::string>());
+				}
+			}
+		}
+
+		if (!response_stream.m_head_request)
+		{
+			response_stream.m_response_body = response.get_body_raw();
+		}
+
+		const bool has_body = !response_stream.m_response_body.empty();
+
+		std::string block;
+		m_encoder.encode(headers, block);
+
+		// a block bigger than a frame continues in CONTINUATION frames
+		size_t offset = 0;
+
+		do
+		{
+			const size_t chunk = std::min<size_t>(block.size() - offset, m_peer_max_frame_size);
+			const bool last = offset + chunk == block.size();
+
+			uint8_t flags = last ? end_headers_flag : 0;
+
+			if (offset == 0 && !has_body)
+				flags |= end_stream_flag;
+
+			write_frame(offset == 0 ? headers_frame : continuation_frame, flags, stream_id, block.data() + offset, chunk);
+			offset += chunk;
+		} while (offset < block.size());
+
+		if (!has_body)
+		{
+			m_streams.erase(it);
+			return;
+		}
+
+		response_stream.m_responding = true;
+		send_pending_data();
+	}
+
+	void http2_session::send_pending_data()
+	{
+		bool progress = true;
+		const size_t max_queued_data = m_settings.m_max_queued_output / 2;
+
+		// the rest follows once the queued output is written
+		while (progress && m_send_window > 0 && m_output.size() < max_queued_data)
+		{
+			progress = false;
+
+			for (auto it = m_streams.begin(); it != m_streams.end() && m_send_window > 0 && m_output.size() < max_queued_data;)
+			{
+				auto& response_stream = it->second;
+
+				if (!response_stream.m_responding || response_stream.m_send_window <= 0)
+				{
+					it++;
+					continue;
+				}
+
+				const int64_t remaining = static_cast<int64_t>(response_stream.m_response_body.size() - response_stream.m_response_offset);
+				const int64_t chunk = std::min({ remaining, static_cast<int64_t>(m_peer_max_frame_size), m_send_window, response_stream.m_send_window });
+				const bool last = chunk == remaining;
+
+				write_frame(data_frame, last ? end_stream_flag : 0, it->first, response_stream.m_response_body.data() + response_stream.m_response_offset, static_cast<size_t>(chunk));
+
+				response_stream.m_response_offset += static_cast<size_t>(chunk);
+				response_stream.m_send_window -= chunk;
+				m_send_window -= chunk;
+				progress = true;
+
+				if (last)
+				{
+					it = m_streams.erase(it);
+				}
+				else
+				{
+					it++;
+				}
+			}
+		}
+	}
+
+	void http2_session::write_frame(const uint8_t type, const uint8_t flags, const uint32_t stream_id, const void* payload, const size_t length)
+	{
+		m_output.push_back(static_cast<char>(length >> 16));
+		m_output.push_back(static_cast<char>(length >> 8));
+		m_output.push_back(static_cast<char>(length));
+		m_output.push_back(static_cast<char>(type));
+		m_output.push_back(static_cast<char>(flags));
+		append_uint32(m_output, stream_id & 0x7fffffff);
+
+		if (length != 0)
+		{
+			m_output.append(static_cast<const char*>(payload), length);
+		}
+	}
+
+	void http2_session::write_settings()
+	{
+		std::string payload;
+
+		append_setting(payload, max_concurrent_streams_setting, m_settings.m_max_concurrent_streams);
+		append_setting(payload, initial_window_size_setting, m_settings.m_initial_window_size);
+		append_setting(payload, max_frame_size_setting, m_settings.m_max_frame_size);
+		append_setting(payload, max_header_list_size_setting, m_settings.m_max_header_list_size);
+
+		write_frame(settings_frame, 0, 0, payload.data(), payload.size());
+	}
+
+	void http2_session::write_window_update(const uint32_t stream_id, const uint32_t increment)
+	{
+		std::string payload;
+		append_uint32(payload, increment & 0x7fffffff);
+
+		write_frame(window_update_frame, 0, stream_id, payload.data(), payload.size());
+	}
+
+	void http2_session::reset_stream(const uint32_t stream_id, const uint32_t error_code)
+	{
+		std::string payload;
+		append_uint32(payload, error_code);
+
+		write_frame(rst_stream_frame, 0, stream_id, payload.data(), payload.size());
+	}
+
+	bool http2_session::fail(const uint32_t error_code)
+	{
+		std::string payload;
+		append_uint32(payload, m_last_stream_id);
+		append_uint32(payload, error_code);
+
+		write_frame(goaway_frame, 0, 0, payload.data(), payload.size());
+
+		m_close_after_write = true;
+		flush();
+
+		return false;
+	}
+
+	void http2_session::flush()
+	{
+		if (m_write_in_progress || m_closed)
+		{
+			return;
+		}
+
+		if (m_output.empty())
+		{
+			if (m_close_after_write)
+				close_connection();
+
+			return;
+		}
+
+		m_write_in_progress = true;
+		m_writing.swap(m_output);
+
+		boost::asio::async_write(*m_socket, boost::asio::buffer(m_writing), boost::asio::bind_executor(m_strand,
+			[self = shared_from_this()](const boost::system::error_code& err, const size_t) {
+				self->on_write(err);
+			}));
+	}
+
+	void http2_session::on_write(const boost::system::error_code& err)
+	{
+		m_write_in_progress = false;
+		m_writing.clear();
+
+		if (err)
+		{
+			close_connection();
+			return;
+		}
+
+		if (!m_close_after_write)
+			send_pending_data();
+
+		flush();
+	}
+
+	void http2_session::close_connection()
+	{
+		if (m_closed)
+		{
+			return;
+		}
+
+		m_closed = true;
+
+		while (!m_streams.empty())
+		{
+			erase_stream(m_streams.begin());
+		}
+
+		boost::system::error_code ignored;
+		m_socket->lowest_layer().close(ignored);
+
+		if (m_on_closed)
+			m_on_closed();
+	}
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ssl.hpp>
+
+#include "hpack.hpp"
+#include "http_request.hpp"
+#include "http_response.hpp"
+
+namespace net
+{
+	struct http2_settings
+	{
+		// streams a client may have open at once, more are refused
+		uint32_t m_max_concurrent_streams = 256;
+		// receive window of every stream, WINDOW_UPDATEs keep it open while the body is read
+		uint32_t m_initial_window_size = 1 << 20;
+		// receive window of the whole connection
+		uint32_t m_connection_window_size = 16 << 20;
+		uint32_t m_max_frame_size = 16384;
+		uint32_t m_max_header_list_size = 65536;
+		// bigger request bodies are answered with 413 and the rest of the stream is reset
+		size_t m_max_request_body_size = 16 << 20;
+		// output waiting for a client that doesn't read, past it the connection ends with ENHANCE_YOUR_CALM;
+		// response data fills at most half of it so control frames always fit
+		size_t m_max_queued_output = 1 << 20;
+	};
+
+	// server side of an http/2 connection (rfc 9113) negotiated with ALPN, every stream becomes an http_request;
+	// everything except the request handlers runs on a strand of the socket's executor
+	class http2_session : public std::enable_shared_from_this<http2_session>
+	{
+	public:
+		typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> socket_type;
+		// called on the worker threads, several streams of one connection are handled in parallel
+		typedef std::function<http_response(std::shared_ptr<http_request>)> request_handler;
+
+		http2_session(std::shared_ptr<socket_type> socket, const http2_settings& settings, const request_handler& handler, const std::function<void()>& on_closed);
+
+		http2_session(const http2_session&) = delete;
+		http2_session& operator=(const http2_session&) = delete;
+
+		void start();
+		// can be called from any thread
+		void close();
+
+	private:
+		struct stream
+		{
+			header_list m_headers;
+			std::vector<uint8_t> m_body;
+			int64_t m_send_window = 0;
+			int64_t m_recv_window = 0;
+			// bytes read since the last WINDOW_UPDATE
+			uint32_t m_nr_unacked_bytes = 0;
+			bool m_remote_closed = false;
+			bool m_head_request = false;
+			bool m_responding = false;
+			// the handler is running, set once the stream is gone so a queued one is skipped
+			bool m_handling = false;
+			std::shared_ptr<std::atomic<bool>> m_reset;
+			std::vector<uint8_t> m_response_body;
+			size_t m_response_offset = 0;
+		};
+
+		void read();
+		void on_read(const boost::system::error_code& err, const size_t nr_bytes);
+		// false once the connection can't go on
+		bool process_input();
+		bool process_frame(const uint8_t type, const uint8_t flags, const uint32_t stream_id, const uint8_t* payload, const uint32_t length);
+
+		bool on_headers(const uint8_t flags, const uint32_t stream_id, const uint8_t* payload, uint32_t length);
+		bool on_continuation(const uint8_t flags, const uint32_t stream_id, const uint8_t* payload, const uint32_t length);
+		bool on_header_block_completed();
+		bool on_data(const uint8_t flags, const uint32_t stream_id, const uint8_t* payload, uint32_t length);
+		bool on_settings(const uint8_t flags, const uint32_t stream_id, const uint8_t* payload, const uint32_t length);
+		bool on_window_update(const uint32_t stream_id, const uint8_t* payload, const uint32_t length);
+		bool on_rst_stream(const uint32_t stream_id, const uint32_t length);
+		bool on_ping(const uint8_t flags, const uint32_t stream_id, const uint8_t* payload, const uint32_t length);
+
+		// a stream whose handler is still running keeps counting against the concurrency limit until it's done
+		void erase_stream(std::map<uint32_t, stream>::iterator it);
+		void dispatch(const uint32_t stream_id, stream& request_stream);
+		std::shared_ptr<http_request> build_request(stream& request_stream);
+		void on_response(const uint32_t stream_id, http_response&& response);
+		// sends as much pending response data as the flow control windows allow, one frame per stream in turn
+		void send_pending_data();
+
+		void write_frame(const uint8_t type, const uint8_t flags, const uint32_t stream_id, const void* payload, const size_t length);
+		void write_settings();
+		void write_window_update(const uint32_t stream_id, const uint32_t increment);
+		void reset_stream(const uint32_t stream_id, const uint32_t error_code);
+		// connection error, nothing is read anymore and the socket is closed once GOAWAY is out
+		bool fail(const uint32_t error_code);
+		void flush();
+		void on_write(const boost::system::error_code& err);
+		void close_connection();
+
+		std::shared_ptr<socket_type> m_socket;
+		boost::asio::strand<boost::asio::any_io_executor> m_strand;
+		const http2_settings m_settings;
+		request_handler m_handler;
+		std::function<void()> m_on_closed;
+
+		hpack_decoder m_decoder;
+		hpack_encoder m_encoder;
+
+		std::vector<uint8_t> m_read_buffer;
+		std::vector<uint8_t> m_input;
+		bool m_preface_received = false;
+
+		std::map<uint32_t, stream> m_streams;
+		uint32_t m_last_stream_id = 0;
+		// handlers still running for streams that were reset
+		size_t m_nr_orphaned_handlers = 0;
+
+		// header block split over CONTINUATION frames
+		std::string m_header_block;
+		uint32_t m_header_stream_id = 0;
+		bool m_header_end_stream = false;
+
+		// set by the client's SETTINGS
+		uint32_t m_peer_max_frame_size = 16384;
+		int64_t m_peer_initial_window_size = 65535;
+
+		int64_t m_send_window = 65535;
+		int64_t m_recv_window = 0;
+		uint32_t m_nr_unacked_bytes = 0;
+
+		std::string m_output;
+		std::string m_writing;
+		bool m_write_in_progress = false;
+		bool m_close_after_write = false;
+		bool m_closed = false;
+	};
+}
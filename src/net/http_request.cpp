@@ -39,6 +39,11 @@ namespace net
 		return m_type;
 	}
 
+	bool http_request::is_idempotent() const
+	{
+		return m_type != request_type::POST && m_type != request_type::PATCH;
+	}
+
 	std::string http_request::to_string(const bool decrypt) const
 	{
 		std::stringstream ss;
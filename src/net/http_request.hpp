@@ -25,6 +25,8 @@ namespace net
 		std::string get_method() const;
 		void set_method(const std::string& method);
 		request_type get_type() const;
+		// safe to send again, the server ends up in the same state
+		bool is_idempotent() const;
 		virtual std::string to_string(const bool decrypt = false) const override;
 		virtual bool load_header_prefix(std::istringstream& iss) noexcept override;
 	private:
@@ -1,10 +1,73 @@
 #include "ihttp_message.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
+#include <string_view>
 #include "../utile/gzip_helpers.hpp"
 
 namespace net
 {
+	namespace
+	{
+		bool equals_lowercase(const std::string_view value, const std::string_view lower_value)
+		{
+			return std::equal(value.begin(), value.end(), lower_value.begin(), lower_value.end(), [](unsigned char a, unsigned char b) { return std::tolower(a) == b; });
+		}
+
+		// names keep the case they were sent in, http/2 sends them in lowercase
+		template <typename J>
+		auto find_header(J& header, const std::string_view lower_name) -> decltype(header.begin())
+		{
+			if (!header.is_object())
+			{
+				return header.end();
+			}
+
+			for (auto it = header.begin(); it != header.end(); it++)
+			{
+				if (equals_lowercase(it.key(), lower_name))
+				{
+					return it;
+				}
+			}
+
+			return header.end();
+		}
+
+		// the codings get_body_decrypted and decompress_body inflate, the zlib header tells deflate apart from gzip
+		bool is_body_inflatable(const nlohmann::json& header)
+		{
+			auto it = find_header(header, "content-encoding");
+
+			if (it == header.end() || !it->is_string())
+			{
+				return false;
+			}
+
+			const auto& encoding = it->get_ref<const std::string&>();
+
+			return equals_lowercase(encoding, "gzip") || equals_lowercase(encoding, "x-gzip") || equals_lowercase(encoding, "deflate");
+		}
+	}
+
+	ihttp_message::ihttp_message(const ihttp_message& other)
+		: m_header_data(other.m_header_data)
+		, m_body_data(other.m_body_data)
+	{
+	}
+
+	ihttp_message& ihttp_message::operator=(const ihttp_message& other)
+	{
+		if (this != &other)
+		{
+			m_header_data = other.m_header_data;
+			m_body_data = other.m_body_data;
+		}
+
+		return *this;
+	}
+
 	boost::asio::streambuf& ihttp_message::get_buffer()
 	{
 		return m_buffer;
@@ -20,26 +83,30 @@ namespace net
 		return m_body_data;
 	}
 
+	size_t ihttp_message::get_body_size() const noexcept
+	{
+		return m_body_data.size();
+	}
+
 	bool ihttp_message::is_body_encoded() const
 	{
-		auto it = m_header_data.find("Content-Encoding");
+		auto it = find_header(m_header_data, "content-encoding");
 
 		return it != m_header_data.end() && it->is_string();
 	}
 
 	std::vector<uint8_t> ihttp_message::get_body_decrypted() const
 	{
-		if (auto it = m_header_data.find("Content-Encoding"); it != m_header_data.end() && it->is_string())
-		{
-			auto encoding_type = it->get<std::string>();
+		// ignoring errs for now
+		utile::gzip_error err;
+		return get_body_decrypted(DEFAULT_DECOMPRESSION_LIMITS, err);
+	}
 
-			// only gzip support for now
-			if (encoding_type.find("gzip") != std::string::npos)
-			{
-				// ignoring errs for now
-				utile::gzip_error err;
-				return utile::gzip::decompress(m_body_data, err);
-			}
+	std::vector<uint8_t> ihttp_message::get_body_decrypted(const utile::gzip::decompression_limits& limits, utile::gzip_error& err) const
+	{
+		if (is_body_inflatable(m_header_data))
+		{
+			return utile::gzip::decompress(m_body_data, err, limits);
 		}
 
 		return m_body_data;
@@ -57,18 +124,23 @@ namespace net
 	}
 
 	utile::gzip_error ihttp_message::gzip_compress_body()
+	{
+		return compress_body(utile::gzip::format::gzip, utile::gzip::BEST_COMPRESSION);
+	}
+
+	utile::gzip_error ihttp_message::compress_body(const utile::gzip::format output_format, const int level, const size_t nr_threads)
 	{
 		utile::gzip_error rez; 
 
-		if (auto it = m_header_data.find("Content-Encoding"); it == m_header_data.end())
+		if (find_header(m_header_data, "content-encoding") == m_header_data.end())
 		{
-			m_header_data["Content-Encoding"] = "gzip";
-
-			auto compressed_body = utile::gzip::compress(m_body_data, rez);
+			auto compressed_body = nr_threads == 1 ? utile::gzip::compress(m_body_data, rez, level, output_format)
+				: utile::gzip::compress_parallel(m_body_data, rez, level, output_format, nr_threads);
 
 			if (rez)
 			{
-				m_body_data = compressed_body;
+				m_header_data["Content-Encoding"] = output_format == utile::gzip::format::gzip ? "gzip" : "deflate";
+				m_body_data = std::move(compressed_body);
 				m_header_data["Content-Length"] = m_body_data.size();
 			}
 		}
@@ -76,6 +148,45 @@ namespace net
 		return rez;
 	}
 
+	utile::gzip_error ihttp_message::decompress_body(const utile::gzip::decompression_limits& limits)
+	{
+		utile::gzip_error rez;
+
+		// no body at all, nothing to inflate
+		if (m_body_data.empty() || !is_body_inflatable(m_header_data))
+		{
+			return rez;
+		}
+
+		auto decompressed_body = utile::gzip::decompress(m_body_data, rez, limits);
+
+		if (rez)
+		{
+			m_header_data.erase(find_header(m_header_data, "content-encoding"));
+			m_body_data = std::move(decompressed_body);
+
+			if (auto length = find_header(m_header_data, "content-length"); length != m_header_data.end())
+				*length = m_body_data.size();
+			else
+				m_header_data["Content-Length"] = m_body_data.size();
+		}
+
+		return rez;
+	}
+
+	void ihttp_message::set_header_value(const std::string& name, const nlohmann::json& value)
+	{
+		m_header_data[name] = value;
+	}
+
+	void ihttp_message::remove_header_value(const std::string& name)
+	{
+		if (m_header_data.is_object())
+		{
+			m_header_data.erase(name);
+		}
+	}
+
 	std::string ihttp_message::extract_header_from_buffer()
 	{
 		const char* data = boost::asio::buffer_cast<const char*>(m_buffer.data());
@@ -9,12 +9,21 @@
 #include "web_helpers.hpp"
 
 #include "../utile/generic_error.hpp"
+#include "../utile/gzip_helpers.hpp"
 
 namespace net
 {
 	class ihttp_message
 	{
 	public:
+		// a body sent compressed can inflate to gigabytes, this bounds what get_body_decrypted() and to_string(true) inflate
+		static constexpr utile::gzip::decompression_limits DEFAULT_DECOMPRESSION_LIMITS{ 64 * 1024 * 1024, 0 };
+
+		ihttp_message() = default;
+		// only the parsed message is copied, not the buffer it was read from
+		ihttp_message(const ihttp_message& other);
+		ihttp_message& operator=(const ihttp_message& other);
+		virtual ~ihttp_message() = default;
 
 		virtual std::string to_string(const bool decrypt = false) const = 0;
 		virtual bool load_header_prefix(std::istringstream& iss) noexcept = 0;
@@ -22,10 +31,19 @@ namespace net
 		boost::asio::streambuf& get_buffer();
 		nlohmann::json get_header() const;
 		std::vector<uint8_t> get_body_raw() const;
+		size_t get_body_size() const noexcept;
+		// inflates to at most DEFAULT_DECOMPRESSION_LIMITS
 		std::vector<uint8_t> get_body_decrypted() const;
+		// the body as it is when decompressing fails or goes past the limits
+		std::vector<uint8_t> get_body_decrypted(const utile::gzip::decompression_limits& limits, utile::gzip_error& err) const;
 		nlohmann::json get_json_body() const;
 
 		utile::gzip_error gzip_compress_body();
+		// sets Content-Encoding to gzip or deflate, a body that is already encoded is left alone;
+		// with nr_threads other than 1 the body is split over that many threads, 0 for one per core
+		utile::gzip_error compress_body(const utile::gzip::format output_format, const int level, const size_t nr_threads = 1);
+		// inflates a gzip or deflate body in place and drops Content-Encoding, other encodings are left alone
+		utile::gzip_error decompress_body(const utile::gzip::decompression_limits& limits);
 
 		template <typename T>
 		std::optional<T> get_header_value(const std::string& name) try
@@ -42,6 +60,10 @@ namespace net
 			return std::nullopt;
 		}
 
+		// replaces the value if the header is already present
+		void set_header_value(const std::string& name, const nlohmann::json& value);
+		void remove_header_value(const std::string& name);
+
 		bool build_header_from_data_recieved();
 		void finalize_message();
 
@@ -0,0 +1,55 @@
+#include "io_context_pool.hpp"
+
+namespace net
+{
+	io_context_pool::io_context_pool(const size_t nr_threads)
+	{
+		// hardware_concurrency is allowed to return 0
+		const auto nr_contexts = nr_threads == 0 ? 1 : nr_threads;
+
+		for (size_t i = 0; i < nr_contexts; i++)
+		{
+			m_contexts.push_back(std::make_unique<boost::asio::io_context>(1));
+			m_idle_work.push_back(boost::asio::make_work_guard(*m_contexts.back()));
+		}
+
+		for (auto& context : m_contexts)
+		{
+			m_threads.emplace_back([&context]() { context->run(); });
+		}
+	}
+
+	io_context_pool::~io_context_pool()
+	{
+		stop();
+	}
+
+	boost::asio::io_context& io_context_pool::get_io_context() noexcept
+	{
+		return *m_contexts[m_next_context++ % m_contexts.size()];
+	}
+
+	size_t io_context_pool::size() const noexcept
+	{
+		return m_contexts.size();
+	}
+
+	void io_context_pool::stop()
+	{
+		for (auto& work : m_idle_work)
+		{
+			work.reset();
+		}
+
+		for (auto& context : m_contexts)
+		{
+			context->stop();
+		}
+
+		for (auto& thread : m_threads)
+		{
+			if (thread.joinable())
+				thread.join();
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace net
+{
+	// a few io_contexts each run by one thread, clients built on them share those threads
+	// instead of running one each; handed out round robin
+	class io_context_pool
+	{
+	public:
+		io_context_pool(const size_t nr_threads = std::thread::hardware_concurrency());
+		~io_context_pool();
+
+		io_context_pool(const io_context_pool&) = delete;
+		io_context_pool& operator=(const io_context_pool&) = delete;
+
+		boost::asio::io_context& get_io_context() noexcept;
+		size_t size() const noexcept;
+
+		// stops the threads, clients using the pool must be destroyed before
+		void stop();
+
+	private:
+		typedef boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work_guard;
+
+		std::vector<std::unique_ptr<boost::asio::io_context>> m_contexts;
+		std::vector<work_guard> m_idle_work;
+		std::vector<std::thread> m_threads;
+		std::atomic<size_t> m_next_context = 0;
+	};
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include <boost/asio.hpp>
+
+namespace net
+{
+	struct listener_options
+	{
+		// size of the kernel queue for connections not yet accepted
+		int m_backlog = boost::asio::socket_base::max_listen_connections;
+
+		// connections already queued by the kernel that are accepted on a single wakeup
+		uint32_t m_max_accepts_per_wakeup = 16;
+
+		// seconds the kernel waits for the first bytes before waking the acceptor, 0 to disable (linux only)
+		uint32_t m_defer_accept_timeout = 0;
+
+		// length of the TCP fast open queue, 0 to disable
+		uint32_t m_fast_open_queue_length = 0;
+
+		// options applied to every accepted socket
+		bool m_no_delay = true;
+		std::optional<int> m_receive_buffer_size = std::nullopt;
+		std::optional<int> m_send_buffer_size = std::nullopt;
+	};
+}
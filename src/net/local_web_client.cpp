@@ -0,0 +1,78 @@
+#include "local_web_client.hpp"
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+namespace net
+{
+	local_web_client::local_web_client() : base_web_client<boost::asio::local::stream_protocol::socket>()
+	{
+		set_socket(std::make_shared<boost::asio::local::stream_protocol::socket>(m_io_service));
+	}
+
+	local_web_client::local_web_client(boost::asio::io_context& io_context) : base_web_client<boost::asio::local::stream_protocol::socket>(io_context)
+	{
+		set_socket(std::make_shared<boost::asio::local::stream_protocol::socket>(m_io_service));
+	}
+
+	bool local_web_client::connect(const std::string& url, const std::optional<std::string>&) noexcept try
+	{
+		{
+			std::scoped_lock lock(m_mutex);
+			if (m_socket->lowest_layer().is_open())
+			{
+				return false;
+			}
+		}
+
+		m_socket->connect(boost::asio::local::stream_protocol::endpoint(url));
+
+		// there is no host name behind a socket file
+		m_host = "localhost";
+		set_connection_data(url, "");
+
+		return true;
+	}
+	catch (const std::exception& err)
+	{
+		std::cerr << "Failed to connect to server, err: " << err.what();
+		return false;
+	}
+
+	void local_web_client::async_connect(const std::string& url, const std::optional<std::string>&, const async_connect_callback& callback, const uint16_t timeout) noexcept
+	{
+		boost::asio::post(m_io_service, [this, url, callback, timeout]() {
+			{
+				std::scoped_lock lock(m_mutex);
+				if (m_socket->lowest_layer().is_open())
+				{
+					if (callback)
+						callback(utile::web_error(std::error_code(EISCONN, std::generic_category()), "Already connected"));
+					return;
+				}
+			}
+
+			auto attempt = start_connect_attempt(callback, timeout);
+
+			m_socket->async_connect(boost::asio::local::stream_protocol::endpoint(url), [this, attempt, url](const boost::system::error_code& error) {
+				if (is_finished(attempt))
+				{
+					return;
+				}
+
+				if (error)
+				{
+					finish_connect_attempt(attempt, utile::web_error(std::error_code(error.value(), std::generic_category()), error.message()));
+					return;
+				}
+
+				// there is no host name behind a socket file
+				m_host = "localhost";
+				set_connection_data(url, "");
+
+				finish_connect_attempt(attempt, utile::web_error());
+				});
+			});
+	}
+} // namespace net
+
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
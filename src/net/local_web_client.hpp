@@ -0,0 +1,23 @@
+#pragma once
+
+#include "base_web_client.hpp"
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+namespace net
+{
+	// http client talking to a local_web_server over a unix domain socket
+	class local_web_client : public base_web_client<boost::asio::local::stream_protocol::socket>
+	{
+	public:
+		local_web_client();
+		local_web_client(boost::asio::io_context& io_context);
+		virtual ~local_web_client() = default;
+
+		// url is the path of the socket file, port is ignored
+		virtual bool connect(const std::string& url, const std::optional<std::string>& port = std::nullopt) noexcept override;
+		virtual void async_connect(const std::string& url, const std::optional<std::string>& port, const async_connect_callback& callback, const uint16_t timeout = 0) noexcept override;
+	};
+}
+
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
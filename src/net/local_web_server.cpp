@@ -0,0 +1,62 @@
+#include "local_web_server.hpp"
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+#include <cstdio>
+#include <filesystem>
+
+namespace net
+{
+	local_web_server::local_web_server(const std::string& socket_path, const uint64_t max_nr_connections, 
+		const uint64_t number_threads, const listener_options& options)
+		: base_web_server(boost::asio::local::stream_protocol::endpoint(socket_path), max_nr_connections, number_threads, options)
+		, m_socket_path(socket_path)
+	{
+		m_build_client_socket_function = [](boost::asio::io_context& context) {
+			return std::make_shared<boost::asio::local::stream_protocol::socket>(context);
+		};
+
+		set_build_client_socket_function(m_build_client_socket_function);
+	}
+
+	local_web_server::~local_web_server()
+	{
+		// the socket file goes with the listener, the base destructor can't reach on_server_stop anymore
+		stop();
+	}
+
+	std::string local_web_server::get_socket_path() const
+	{
+		return m_socket_path;
+	}
+
+	void local_web_server::on_server_start() noexcept
+	{
+		std::error_code errcode;
+
+		if (!std::filesystem::is_socket(m_socket_path, errcode))
+		{
+			return;
+		}
+
+		// only a file nobody listens on is removed, with a server still running there the bind fails instead
+		boost::asio::io_context context;
+		boost::asio::local::stream_protocol::socket probe(context);
+		boost::system::error_code probe_error;
+
+		probe.connect(boost::asio::local::stream_protocol::endpoint(m_socket_path), probe_error);
+
+		if (probe_error == boost::asio::error::connection_refused)
+		{
+			std::remove(m_socket_path.c_str());
+		}
+	}
+
+	void local_web_server::on_server_stop() noexcept
+	{
+		// start() only gets past the bind with the file being its own
+		std::remove(m_socket_path.c_str());
+	}
+}
+
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "base_web_server.hpp"
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+
+namespace net
+{
+	// http server listening on a unix domain socket, for clients living on the same host
+	class local_web_server : public base_web_server<boost::asio::local::stream_protocol::socket>
+	{
+	public:
+		// start() removes a socket file left at socket_path by a server that is gone, stop() removes its own
+		local_web_server(const std::string& socket_path, const uint64_t max_nr_connections = 1000, const uint64_t number_threads = 4, const listener_options& options = listener_options());
+		virtual ~local_web_server();
+
+		std::string get_socket_path() const;
+	protected:
+		virtual void on_server_start() noexcept override;
+		virtual void on_server_stop() noexcept override;
+	private:
+		std::string m_socket_path;
+		std::function<std::shared_ptr<boost::asio::local::stream_protocol::socket>(boost::asio::io_context&)> m_build_client_socket_function = nullptr;
+	};
+}
+
+#endif // BOOST_ASIO_HAS_LOCAL_SOCKETS
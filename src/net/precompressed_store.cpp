@@ -0,0 +1,234 @@
+#include "precompressed_store.hpp"
+
+#include <fstream>
+#include <iterator>
+
+namespace net
+{
+	namespace
+	{
+		std::optional<std::vector<uint8_t>> read_file(const std::string& path)
+		{
+			std::ifstream file(path, std::ios::binary);
+
+			if (!file)
+			{
+				return std::nullopt;
+			}
+
+			return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+
+		std::string guess_content_type(const std::string& path)
+		{
+			static const std::map<std::string, std::string> types = {
+				{ ".html", "text/html; charset=utf-8" },
+				{ ".htm", "text/html; charset=utf-8" },
+				{ ".css", "text/css; charset=utf-8" },
+				{ ".js", "application/javascript" },
+				{ ".mjs", "application/javascript" },
+				{ ".json", "application/json" },
+				{ ".xml", "application/xml" },
+				{ ".svg", "image/svg+xml" },
+				{ ".txt", "text/plain; charset=utf-8" },
+				{ ".png", "image/png" },
+				{ ".jpg", "image/jpeg" },
+				{ ".jpeg", "image/jpeg" },
+				{ ".gif", "image/gif" },
+				{ ".webp", "image/webp" },
+				{ ".ico", "image/x-icon" },
+				{ ".wasm", "application/wasm" }
+			};
+
+			if (auto dot = path.find_last_of('.'); dot != std::string::npos && path.find_first_of("/\\", dot) == std::string::npos)
+			{
+				if (auto it = types.find(path.substr(dot)); it != types.end())
+				{
+					return it->second;
+				}
+			}
+
+			return "application/octet-stream";
+		}
+
+		size_t get_response_size(const http_response& response)
+		{
+			return response.get_body_size() + response.get_header().dump().size();
+		}
+	}
+
+	precompressed_store::precompressed_store(const compression_options& options) : m_options(options)
+	{
+	}
+
+	compression_options precompressed_store::default_options()
+	{
+		compression_options rez;
+		rez.m_level = utile::gzip::BEST_COMPRESSION;
+
+		return rez;
+	}
+
+	void precompressed_store::add(const std::string& method, const http_response& response)
+	{
+		std::optional<http_response> gzip = std::nullopt;
+
+		// the same rules as for compressing on the fly, an accepting request stands in for every client
+		http_request accepting_request(request_type::GET, method, content_type::any, { { "Accept-Encoding", "gzip" } });
+		http_response compressed = response;
+
+		compress_response(accepting_request, compressed, m_options);
+
+		if (find_header_value(compressed, "Content-Encoding") == std::optional<std::string>("gzip") && find_header_value(response, "Content-Encoding") == std::nullopt)
+		{
+			// not worth a variant when it didn't get smaller
+			if (compressed.get_body_size() < response.get_body_size())
+			{
+				gzip = compressed;
+			}
+		}
+
+		http_response identity = response;
+
+		if (gzip != std::nullopt)
+		{
+			identity.set_header_value("Vary", *find_header_value(*gzip, "Vary"));
+		}
+
+		store(method, std::move(identity), std::move(gzip));
+	}
+
+	bool precompressed_store::add_file(const std::string& method, const std::string& path, const std::optional<std::string>& content_type)
+	{
+		auto body = read_file(path);
+
+		if (body == std::nullopt)
+		{
+			return false;
+		}
+
+		nlohmann::json header = { { "Content-Type", content_type.value_or(guess_content_type(path)) } };
+
+		auto compressed_body = read_file(path + ".gz");
+
+		if (compressed_body == std::nullopt)
+		{
+			add(method, http_response(200, "OK", header, *body));
+			return true;
+		}
+
+		header["Vary"] = "Accept-Encoding";
+
+		http_response gzip(200, "OK", header, *compressed_body);
+		gzip.set_header_value("Content-Encoding", "gzip");
+
+		store(method, http_response(200, "OK", header, *body), std::move(gzip));
+
+		return true;
+	}
+
+	void precompressed_store::remove(const std::string& method)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		if (auto it = m_entries.find(method); it != m_entries.end())
+		{
+			m_size -= get_response_size(*it->second.m_identity) + (it->second.m_gzip ? get_response_size(*it->second.m_gzip) : 0);
+			m_entries.erase(it);
+		}
+	}
+
+	void precompressed_store::clear()
+	{
+		std::scoped_lock lock(m_mutex);
+
+		m_entries.clear();
+		m_size = 0;
+	}
+
+	std::optional<http_response> precompressed_store::get(const http_request& request)
+	{
+		std::shared_ptr<const http_response> rez = nullptr;
+		bool compressed = false;
+
+		{
+			std::scoped_lock lock(m_mutex);
+
+			auto it = m_entries.find(request.get_method());
+
+			if (it == m_entries.end())
+			{
+				return std::nullopt;
+			}
+
+			rez = it->second.m_identity;
+
+			if (it->second.m_gzip != nullptr)
+			{
+				if (auto accept_encoding = find_header_value(request, "Accept-Encoding"); accept_encoding && negotiate_encoding(*accept_encoding) == utile::gzip::format::gzip)
+				{
+					rez = it->second.m_gzip;
+					compressed = true;
+				}
+			}
+		}
+
+		if (compressed)
+			m_nr_compressed_served++;
+		else
+			m_nr_identity_served++;
+
+		// copied outside of the lock
+		return *rez;
+	}
+
+	http_response precompressed_store::serve(const http_request& request)
+	{
+		if (auto rez = get(request); rez != std::nullopt)
+		{
+			return std::move(*rez);
+		}
+
+		return http_response(404, "Not Found");
+	}
+
+	size_t precompressed_store::get_size()
+	{
+		std::scoped_lock lock(m_mutex);
+		return m_size;
+	}
+
+	uint64_t precompressed_store::get_nr_compressed_served() const noexcept
+	{
+		return m_nr_compressed_served;
+	}
+
+	uint64_t precompressed_store::get_nr_identity_served() const noexcept
+	{
+		return m_nr_identity_served;
+	}
+
+	void precompressed_store::store(const std::string& method, http_response identity, std::optional<http_response> gzip)
+	{
+		variants entry;
+
+		entry.m_identity = std::make_shared<const http_response>(std::move(identity));
+
+		if (gzip != std::nullopt)
+		{
+			entry.m_gzip = std::make_shared<const http_response>(std::move(*gzip));
+		}
+
+		const size_t size = get_response_size(*entry.m_identity) + (entry.m_gzip ? get_response_size(*entry.m_gzip) : 0);
+
+		std::scoped_lock lock(m_mutex);
+
+		if (auto it = m_entries.find(method); it != m_entries.end())
+		{
+			m_size -= get_response_size(*it->second.m_identity) + (it->second.m_gzip ? get_response_size(*it->second.m_gzip) : 0);
+		}
+
+		m_entries[method] = std::move(entry);
+		m_size += size;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "response_compression.hpp"
+
+namespace net
+{
+	// responses that are served over and over (static files, cached json) kept next to their gzip form,
+	// which is compressed once when added or loaded from a .gz file, so serving them costs no compression at all
+	class precompressed_store
+	{
+	public:
+		// the allowlist and minimum size decide which responses get a gzip variant, spending the best level pays off here
+		precompressed_store(const compression_options& options = default_options());
+
+		precompressed_store(const precompressed_store&) = delete;
+		precompressed_store& operator=(const precompressed_store&) = delete;
+
+		// replaces what is stored under the method path
+		void add(const std::string& method, const http_response& response);
+		// path.gz is used as the gzip variant when it exists, the content type is guessed from the extension if not given
+		bool add_file(const std::string& method, const std::string& path, const std::optional<std::string>& content_type = std::nullopt);
+		void remove(const std::string& method);
+		void clear();
+
+		// the variant the request's Accept-Encoding allows, nullopt if nothing is stored under its method path
+		std::optional<http_response> get(const http_request& request);
+		// same but a 404 when nothing is stored, to be returned straight from a handler
+		http_response serve(const http_request& request);
+
+		size_t get_size();
+		uint64_t get_nr_compressed_served() const noexcept;
+		uint64_t get_nr_identity_served() const noexcept;
+
+		static compression_options default_options();
+
+	private:
+		struct variants
+		{
+			std::shared_ptr<const http_response> m_identity;
+			std::shared_ptr<const http_response> m_gzip;
+		};
+
+		void store(const std::string& method, http_response identity, std::optional<http_response> gzip);
+
+		const compression_options m_options;
+		std::mutex m_mutex;
+		std::map<std::string, variants> m_entries;
+		size_t m_size = 0;
+		std::atomic<uint64_t> m_nr_compressed_served = 0;
+		std::atomic<uint64_t> m_nr_identity_served = 0;
+	};
+}
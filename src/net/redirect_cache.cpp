@@ -0,0 +1,210 @@
+#include "redirect_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <set>
+
+namespace net
+{
+	namespace
+	{
+		// a redirect chain longer than this is treated as a loop
+		constexpr size_t MAX_REDIRECT_HOPS = 10;
+	}
+
+	redirect_cache& redirect_cache::get_instance()
+	{
+		static redirect_cache instance;
+		return instance;
+	}
+
+	void redirect_cache::set_default_ttl(const std::chrono::seconds ttl)
+	{
+		std::scoped_lock lock(m_mutex);
+		m_default_ttl = ttl;
+	}
+
+	void redirect_cache::set_max_entries(const size_t max_entries)
+	{
+		assert(max_entries > 0);
+
+		std::scoped_lock lock(m_mutex);
+		m_max_entries = max_entries;
+	}
+
+	void redirect_cache::store(const std::string& host, const std::string& port, const std::string& method, const web_location& location, const std::shared_ptr<http_response>& response)
+	{
+		auto ttl = get_ttl(response);
+
+		if (ttl == std::nullopt)
+		{
+			return;
+		}
+
+		std::scoped_lock lock(m_mutex);
+
+		if (m_entries.size() >= m_max_entries)
+		{
+			remove_expired_entries();
+
+			// still full, make room by dropping the entry closest to expiring
+			if (m_entries.size() >= m_max_entries)
+			{
+				auto oldest = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& left, const auto& right) {
+					return left.second.m_expires_at < right.second.m_expires_at;
+					});
+
+				m_entries.erase(oldest);
+			}
+		}
+
+		cache_entry entry;
+		entry.m_location = location;
+		entry.m_expires_at = std::chrono::steady_clock::now() + *ttl;
+
+		m_entries[build_key(host, port, method)] = entry;
+	}
+
+	std::optional<web_location> redirect_cache::lookup(const std::string& host, const std::string& port, const std::string& method)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		auto now = std::chrono::steady_clock::now();
+
+		std::optional<web_location> rez = std::nullopt;
+		std::set<std::string> visited;
+
+		auto current_host = host;
+		auto current_port = port;
+		auto current_method = method;
+
+		for (size_t hop = 0; hop < MAX_REDIRECT_HOPS; hop++)
+		{
+			auto key = build_key(current_host, current_port, current_method);
+
+			if (!visited.insert(key).second)
+			{
+				// redirect loop, let the server answer again
+				m_entries.erase(build_key(host, port, method));
+				return std::nullopt;
+			}
+
+			auto it = m_entries.find(key);
+
+			if (it == m_entries.end())
+			{
+				return rez;
+			}
+
+			if (it->second.m_expires_at <= now)
+			{
+				m_entries.erase(it);
+				return rez;
+			}
+
+			rez = it->second.m_location;
+
+			if (rez->m_host != "")
+			{
+				current_host = rez->m_host;
+				current_port = rez->m_port;
+			}
+
+			current_method = rez->m_method;
+		}
+
+		m_entries.erase(build_key(host, port, method));
+		return std::nullopt;
+	}
+
+	void redirect_cache::invalidate(const std::string& host, const std::string& port, const std::string& method)
+	{
+		std::scoped_lock lock(m_mutex);
+		m_entries.erase(build_key(host, port, method));
+	}
+
+	void redirect_cache::invalidate(const std::string& host, const std::string& port)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		auto prefix = host + ":" + port + "/";
+
+		for (auto it = m_entries.lower_bound(prefix); it != m_entries.end() && it->first.compare(0, prefix.size(), prefix) == 0;)
+		{
+			it = m_entries.erase(it);
+		}
+	}
+
+	void redirect_cache::clear()
+	{
+		std::scoped_lock lock(m_mutex);
+		m_entries.clear();
+	}
+
+	bool redirect_cache::is_permanent_redirect(const uint16_t status)
+	{
+		return status == 301 || status == 308;
+	}
+
+	std::string redirect_cache::build_key(const std::string& host, const std::string& port, const std::string& method)
+	{
+		// methods start with '/', the prefix search in invalidate relies on it
+		return host + ":" + port + (method.rfind("/", 0) == 0 ? "" : "/") + method;
+	}
+
+	std::optional<std::chrono::seconds> redirect_cache::get_ttl(const std::shared_ptr<http_response>& response)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		if (response == nullptr)
+		{
+			return m_default_ttl;
+		}
+
+		auto cache_control = response->get_header_value<std::string>("Cache-Control");
+
+		if (cache_control == std::nullopt)
+		{
+			return m_default_ttl;
+		}
+
+		if (cache_control->find("no-store") != std::string::npos || cache_control->find("no-cache") != std::string::npos)
+		{
+			return std::nullopt;
+		}
+
+		if (auto poz = cache_control->find("max-age="); poz != std::string::npos) try
+		{
+			auto max_age = std::stoll(cache_control->substr(poz + 8));
+
+			if (max_age <= 0)
+			{
+				return std::nullopt;
+			}
+
+			return std::chrono::seconds(max_age);
+		}
+		catch (...)
+		{
+		}
+
+		return m_default_ttl;
+	}
+
+	void redirect_cache::remove_expired_entries()
+	{
+		auto now = std::chrono::steady_clock::now();
+
+		for (auto it = m_entries.begin(); it != m_entries.end();)
+		{
+			if (it->second.m_expires_at <= now)
+			{
+				it = m_entries.erase(it);
+			}
+			else
+			{
+				it++;
+			}
+		}
+	}
+}
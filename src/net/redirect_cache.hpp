@@ -0,0 +1,59 @@
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "http_response.hpp"
+#include "web_helpers.hpp"
+
+namespace net
+{
+	// process wide cache of permanent redirects (301 and 308) keyed by host:port and method path,
+	// clients rewrite requests to the final location instead of being redirected again
+	class redirect_cache
+	{
+	public:
+		static redirect_cache& get_instance();
+
+		redirect_cache(const redirect_cache&) = delete;
+		redirect_cache& operator=(const redirect_cache&) = delete;
+
+		// ttl used when the redirect response has no max-age
+		void set_default_ttl(const std::chrono::seconds ttl);
+		void set_max_entries(const size_t max_entries);
+
+		void store(const std::string& host, const std::string& port, const std::string& method, const web_location& location, const std::shared_ptr<http_response>& response);
+
+		// follows cached redirects to the last known location, an empty host means the same host
+		std::optional<web_location> lookup(const std::string& host, const std::string& port, const std::string& method);
+
+		void invalidate(const std::string& host, const std::string& port, const std::string& method);
+		void invalidate(const std::string& host, const std::string& port);
+		void clear();
+
+		static bool is_permanent_redirect(const uint16_t status);
+
+	private:
+		redirect_cache() = default;
+
+		struct cache_entry
+		{
+			web_location m_location;
+			std::chrono::steady_clock::time_point m_expires_at;
+		};
+
+		static std::string build_key(const std::string& host, const std::string& port, const std::string& method);
+		std::optional<std::chrono::seconds> get_ttl(const std::shared_ptr<http_response>& response);
+
+		// has to be called with the lock held
+		void remove_expired_entries();
+
+		std::mutex m_mutex;
+		std::chrono::seconds m_default_ttl{ 3600 };
+		size_t m_max_entries = 1024;
+		std::map<std::string, cache_entry> m_entries;
+	};
+}
@@ -0,0 +1,137 @@
+#include "request_policy.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+
+namespace net
+{
+	namespace
+	{
+		// percentiles of fewer samples are mostly noise
+		constexpr size_t MIN_NR_SAMPLES = 32;
+	}
+
+	std::chrono::milliseconds retry_policy::get_backoff(const uint32_t retry) const
+	{
+		thread_local std::mt19937_64 generator{ std::random_device{}() };
+
+		auto max_wait = static_cast<double>(m_initial_backoff.count()) * std::pow(m_backoff_multiplier, retry > 0 ? retry - 1 : 0);
+		max_wait = std::min(max_wait, static_cast<double>(m_max_backoff.count()));
+
+		if (max_wait <= 0)
+		{
+			return std::chrono::milliseconds(0);
+		}
+
+		// full jitter, clients failing together don't retry together
+		std::uniform_int_distribution<int64_t> distribution(0, static_cast<int64_t>(max_wait));
+
+		return std::chrono::milliseconds(distribution(generator));
+	}
+
+	retry_budget::retry_budget(const double ratio, const double min_per_second, const double max_tokens)
+		: m_ratio(ratio)
+		, m_min_per_second(min_per_second)
+		, m_max_tokens(max_tokens)
+		, m_tokens(std::min(min_per_second, max_tokens))
+	{
+		assert(ratio >= 0 && min_per_second >= 0 && max_tokens > 0);
+	}
+
+	void retry_budget::configure(const double ratio, const double min_per_second, const double max_tokens)
+	{
+		assert(ratio >= 0 && min_per_second >= 0 && max_tokens > 0);
+
+		std::scoped_lock lock(m_mutex);
+
+		m_ratio = ratio;
+		m_min_per_second = min_per_second;
+		m_max_tokens = max_tokens;
+		m_tokens = std::min(m_tokens, m_max_tokens);
+	}
+
+	void retry_budget::on_request() noexcept
+	{
+		std::scoped_lock lock(m_mutex);
+
+		refill();
+		m_tokens = std::min(m_tokens + m_ratio, m_max_tokens);
+	}
+
+	bool retry_budget::try_spend() noexcept
+	{
+		std::scoped_lock lock(m_mutex);
+
+		refill();
+
+		if (m_tokens < 1)
+		{
+			m_nr_rejected++;
+			return false;
+		}
+
+		m_tokens -= 1;
+		return true;
+	}
+
+	uint64_t retry_budget::get_nr_rejected() noexcept
+	{
+		std::scoped_lock lock(m_mutex);
+		return m_nr_rejected;
+	}
+
+	void retry_budget::refill() noexcept
+	{
+		auto now = std::chrono::steady_clock::now();
+		auto elapsed = std::chrono::duration<double>(now - m_last_refill).count();
+
+		m_last_refill = now;
+		m_tokens = std::min(m_tokens + elapsed * m_min_per_second, m_max_tokens);
+	}
+
+	latency_tracker::latency_tracker(const size_t nr_samples)
+		: m_samples(nr_samples)
+	{
+		assert(nr_samples >= MIN_NR_SAMPLES);
+	}
+
+	void latency_tracker::record(const std::chrono::milliseconds latency) noexcept
+	{
+		std::scoped_lock lock(m_mutex);
+
+		m_samples[m_next] = latency;
+
+		if (++m_next == m_samples.size())
+		{
+			m_next = 0;
+			m_full = true;
+		}
+	}
+
+	std::optional<std::chrono::milliseconds> latency_tracker::get_percentile(const double percentile)
+	{
+		assert(percentile >= 0 && percentile <= 1);
+
+		std::vector<std::chrono::milliseconds> samples;
+
+		{
+			std::scoped_lock lock(m_mutex);
+
+			auto nr_samples = m_full ? m_samples.size() : m_next;
+
+			if (nr_samples < MIN_NR_SAMPLES)
+			{
+				return std::nullopt;
+			}
+
+			samples.assign(m_samples.begin(), m_samples.begin() + nr_samples);
+		}
+
+		auto nth = samples.begin() + static_cast<size_t>(percentile * (samples.size() - 1));
+		std::nth_element(samples.begin(), nth, samples.end());
+
+		return *nth;
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <vector>
+
+namespace net
+{
+	struct retry_policy
+	{
+		// attempts per request including the first one, 1 disables retries
+		uint32_t m_max_attempts = 1;
+
+		// wait before the first retry, multiplied for every further one and capped; the actual wait is picked at random below it
+		std::chrono::milliseconds m_initial_backoff{ 50 };
+		std::chrono::milliseconds m_max_backoff{ 2000 };
+		double m_backoff_multiplier = 2;
+
+		// responses with these statuses are retried like connection errors and timeouts
+		std::set<uint16_t> m_retry_on_status = { 502, 503, 504 };
+
+		// requests that aren't idempotent might have been processed already, they're only retried if set
+		bool m_retry_non_idempotent = false;
+
+		// wait before the given retry, starting at 1
+		std::chrono::milliseconds get_backoff(const uint32_t retry) const;
+	};
+
+	struct hedging_policy
+	{
+		// duplicates sent at most for a request that is taking too long, 0 disables hedging; only idempotent requests are hedged
+		uint32_t m_max_hedges = 0;
+
+		// wait before a duplicate is sent
+		std::chrono::milliseconds m_delay{ 100 };
+
+		// between 0 and 1, if set the wait follows this percentile of the observed latencies once enough were recorded
+		std::optional<double> m_percentile = std::nullopt;
+	};
+
+	// limits retries and hedges to a fraction of the requests sent so they can't multiply the load of a failing server;
+	// every request deposits ratio tokens, every retry or hedge spends one, min_per_second tokens are added regardless of traffic
+	class retry_budget
+	{
+	public:
+		retry_budget(const double ratio = 0.1, const double min_per_second = 10, const double max_tokens = 100);
+
+		void configure(const double ratio, const double min_per_second, const double max_tokens);
+
+		void on_request() noexcept;
+		// false if the budget is used up, the retry or hedge must not be sent
+		bool try_spend() noexcept;
+
+		uint64_t get_nr_rejected() noexcept;
+
+	private:
+		// has to be called with the lock held
+		void refill() noexcept;
+
+		std::mutex m_mutex;
+		double m_ratio;
+		double m_min_per_second;
+		double m_max_tokens;
+		double m_tokens;
+		uint64_t m_nr_rejected = 0;
+		std::chrono::steady_clock::time_point m_last_refill = std::chrono::steady_clock::now();
+	};
+
+	// latencies of the last nr_samples successful requests
+	class latency_tracker
+	{
+	public:
+		latency_tracker(const size_t nr_samples = 1024);
+
+		void record(const std::chrono::milliseconds latency) noexcept;
+
+		// nullopt until a few samples were recorded
+		std::optional<std::chrono::milliseconds> get_percentile(const double percentile);
+
+	private:
+		std::mutex m_mutex;
+		std::vector<std::chrono::milliseconds> m_samples;
+		size_t m_next = 0;
+		bool m_full = false;
+	};
+}
@@ -0,0 +1,309 @@
+#include "response_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace net
+{
+	namespace
+	{
+		// headers a 304 carries that replace the ones of the stored response
+		const std::vector<std::string> REVALIDATION_HEADERS = { "Cache-Control", "ETag", "Last-Modified", "Expires", "Date" };
+	}
+
+	response_cache& response_cache::get_instance()
+	{
+		static response_cache instance;
+		return instance;
+	}
+
+	void response_cache::set_max_size(const size_t max_size)
+	{
+		assert(max_size > 0);
+
+		std::scoped_lock lock(m_mutex);
+		m_max_size = max_size;
+
+		evict();
+	}
+
+	size_t response_cache::get_size()
+	{
+		std::scoped_lock lock(m_mutex);
+		return m_size;
+	}
+
+	std::shared_ptr<http_response> response_cache::prepare(const std::string& host, const std::string& port, http_request& request)
+	{
+		auto key = build_key(host, port, request.get_method());
+
+		std::scoped_lock lock(m_mutex);
+
+		auto it = m_entries.find(key);
+
+		if (it == m_entries.end())
+		{
+			return nullptr;
+		}
+
+		if (request.get_type() != request_type::GET)
+		{
+			erase(it);
+			return nullptr;
+		}
+
+		auto& entry = it->second;
+
+		touch(entry);
+
+		if (entry.m_expires_at > std::chrono::steady_clock::now())
+		{
+			m_nr_hits++;
+			return std::make_shared<http_response>(*entry.m_response);
+		}
+
+		if (entry.m_etag != std::nullopt)
+		{
+			request.set_header_value("If-None-Match", *entry.m_etag);
+		}
+
+		if (entry.m_last_modified != std::nullopt)
+		{
+			request.set_header_value("If-Modified-Since", *entry.m_last_modified);
+		}
+
+		return nullptr;
+	}
+
+	std::shared_ptr<http_response> response_cache::on_response(const std::string& host, const std::string& port, const std::string& method, const std::shared_ptr<http_response>& response)
+	{
+		if (response == nullptr)
+		{
+			return response;
+		}
+
+		auto key = build_key(host, port, method);
+
+		std::scoped_lock lock(m_mutex);
+
+		auto it = m_entries.find(key);
+
+		if (response->get_status() == 304)
+		{
+			if (it == m_entries.end())
+			{
+				// evicted meanwhile, nothing to hand over instead
+				return response;
+			}
+
+			auto& entry = it->second;
+			auto header = response->get_header();
+
+			for (const auto& name : REVALIDATION_HEADERS)
+			{
+				if (auto value = header.find(name); value != header.end())
+				{
+					entry.m_response->set_header_value(name, *value);
+				}
+			}
+
+			m_nr_revalidations++;
+
+			auto cached = std::make_shared<http_response>(*entry.m_response);
+
+			if (auto freshness = get_freshness(entry.m_response); freshness != std::nullopt)
+			{
+				entry.m_etag = get_header_string(entry.m_response, "ETag");
+				entry.m_last_modified = get_header_string(entry.m_response, "Last-Modified");
+				entry.m_expires_at = std::chrono::steady_clock::now() + *freshness;
+			}
+			else
+			{
+				erase(it);
+			}
+
+			return cached;
+		}
+
+		m_nr_misses++;
+
+		if (it != m_entries.end())
+		{
+			// replaced by the new response or gone
+			erase(it);
+		}
+
+		if (response->get_status() != 200)
+		{
+			return response;
+		}
+
+		if (auto freshness = get_freshness(response); freshness != std::nullopt)
+		{
+			store(key, response, *freshness);
+		}
+
+		return response;
+	}
+
+	void response_cache::invalidate(const std::string& host, const std::string& port, const std::string& method)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		if (auto it = m_entries.find(build_key(host, port, method)); it != m_entries.end())
+		{
+			erase(it);
+		}
+	}
+
+	void response_cache::invalidate(const std::string& host, const std::string& port)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		auto prefix = host + ":" + port + "/";
+
+		for (auto it = m_entries.begin(); it != m_entries.end();)
+		{
+			if (it->first.compare(0, prefix.size(), prefix) == 0)
+			{
+				it = erase(it);
+			}
+			else
+			{
+				it++;
+			}
+		}
+	}
+
+	void response_cache::clear()
+	{
+		std::scoped_lock lock(m_mutex);
+
+		m_entries.clear();
+		m_lru.clear();
+		m_size = 0;
+	}
+
+	uint64_t response_cache::get_nr_hits() const noexcept
+	{
+		return m_nr_hits;
+	}
+
+	uint64_t response_cache::get_nr_revalidations() const noexcept
+	{
+		return m_nr_revalidations;
+	}
+
+	uint64_t response_cache::get_nr_misses() const noexcept
+	{
+		return m_nr_misses;
+	}
+
+	void response_cache::reset_counters() noexcept
+	{
+		m_nr_hits = 0;
+		m_nr_revalidations = 0;
+		m_nr_misses = 0;
+	}
+
+	std::string response_cache::build_key(const std::string& host, const std::string& port, const std::string& method)
+	{
+		// methods start with '/', the prefix search in invalidate relies on it
+		return host + ":" + port + (method.rfind("/", 0) == 0 ? "" : "/") + method;
+	}
+
+	std::optional<std::string> response_cache::get_header_string(const std::shared_ptr<http_response>& response, const std::string& name)
+	{
+		auto header = response->get_header();
+
+		auto it = header.find(name);
+
+		if (it == header.end())
+		{
+			return std::nullopt;
+		}
+
+		// numeric looking values are parsed as numbers when the header is read
+		return it->is_string() ? it->get<std::string>() : it->dump();
+	}
+
+	std::optional<std::chrono::seconds> response_cache::get_freshness(const std::shared_ptr<http_response>& response)
+	{
+		auto cache_control = get_header_string(response, "Cache-Control").value_or("");
+
+		if (cache_control.find("no-store") != std::string::npos)
+		{
+			return std::nullopt;
+		}
+
+		const bool has_validators = get_header_string(response, "ETag") != std::nullopt || get_header_string(response, "Last-Modified") != std::nullopt;
+
+		std::optional<std::chrono::seconds> rez = has_validators ? std::optional<std::chrono::seconds>(0) : std::nullopt;
+
+		if (cache_control.find("no-cache") != std::string::npos)
+		{
+			return rez;
+		}
+
+		if (auto poz = cache_control.find("max-age="); poz != std::string::npos) try
+		{
+			auto max_age = std::stoll(cache_control.substr(poz + 8));
+
+			// time the response already spent in caches on the way
+			max_age -= static_cast<long long>(response->get_header_value<uint64_t>("Age").value_or(0));
+
+			if (max_age > 0)
+			{
+				return std::chrono::seconds(max_age);
+			}
+		}
+		catch (...)
+		{
+		}
+
+		return rez;
+	}
+
+	void response_cache::store(const std::string& key, const std::shared_ptr<http_response>& response, const std::chrono::seconds freshness)
+	{
+		cache_entry entry;
+		entry.m_response = std::make_shared<http_response>(*response);
+		entry.m_expires_at = std::chrono::steady_clock::now() + freshness;
+		entry.m_etag = get_header_string(response, "ETag");
+		entry.m_last_modified = get_header_string(response, "Last-Modified");
+		entry.m_size = key.size() + response->get_body_raw().size() + response->get_header().dump().size();
+
+		if (entry.m_size > m_max_size)
+		{
+			return;
+		}
+
+		m_lru.push_front(key);
+		entry.m_lru_position = m_lru.begin();
+
+		m_size += entry.m_size;
+		m_entries.emplace(key, std::move(entry));
+
+		evict();
+	}
+
+	std::unordered_map<std::string, response_cache::cache_entry>::iterator response_cache::erase(std::unordered_map<std::string, cache_entry>::iterator it)
+	{
+		m_size -= it->second.m_size;
+		m_lru.erase(it->second.m_lru_position);
+		return m_entries.erase(it);
+	}
+
+	void response_cache::touch(cache_entry& entry)
+	{
+		m_lru.splice(m_lru.begin(), m_lru, entry.m_lru_position);
+	}
+
+	void response_cache::evict()
+	{
+		while (m_size > m_max_size && !m_lru.empty())
+		{
+			erase(m_entries.find(m_lru.back()));
+		}
+	}
+}
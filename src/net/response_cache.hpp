@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "http_request.hpp"
+#include "http_response.hpp"
+
+namespace net
+{
+	// process wide cache of GET responses keyed by host:port and method path, honors Cache-Control max-age / no-store / no-cache
+	// and revalidates stale entries with If-None-Match / If-Modified-Since; bounded by a memory budget, least recently used go first
+	class response_cache
+	{
+	public:
+		static response_cache& get_instance();
+
+		response_cache(const response_cache&) = delete;
+		response_cache& operator=(const response_cache&) = delete;
+
+		// bytes of headers and bodies kept at most, responses bigger than it are never stored
+		void set_max_size(const size_t max_size);
+		size_t get_size();
+
+		// a copy of the cached response if it is still fresh, otherwise adds the validators of the stale entry to the request;
+		// requests other than GET invalidate the entry as they might change the resource
+		std::shared_ptr<http_response> prepare(const std::string& host, const std::string& port, http_request& request);
+
+		// to be called with the response to a prepared GET, a 304 refreshes the stale entry and a copy of it is returned instead
+		std::shared_ptr<http_response> on_response(const std::string& host, const std::string& port, const std::string& method, const std::shared_ptr<http_response>& response);
+
+		void invalidate(const std::string& host, const std::string& port, const std::string& method);
+		void invalidate(const std::string& host, const std::string& port);
+		void clear();
+
+		// fresh responses served without a request
+		uint64_t get_nr_hits() const noexcept;
+		// stale responses the server confirmed with a 304
+		uint64_t get_nr_revalidations() const noexcept;
+		uint64_t get_nr_misses() const noexcept;
+		void reset_counters() noexcept;
+
+	private:
+		response_cache() = default;
+
+		struct cache_entry
+		{
+			std::shared_ptr<http_response> m_response;
+			std::chrono::steady_clock::time_point m_expires_at;
+			std::optional<std::string> m_etag;
+			std::optional<std::string> m_last_modified;
+			size_t m_size = 0;
+			std::list<std::string>::iterator m_lru_position;
+		};
+
+		static std::string build_key(const std::string& host, const std::string& port, const std::string& method);
+		static std::optional<std::string> get_header_string(const std::shared_ptr<http_response>& response, const std::string& name);
+		// nullopt if the response must not be stored, 0 means it has to be revalidated before every use
+		static std::optional<std::chrono::seconds> get_freshness(const std::shared_ptr<http_response>& response);
+
+		// have to be called with the lock held
+		void store(const std::string& key, const std::shared_ptr<http_response>& response, const std::chrono::seconds freshness);
+		std::unordered_map<std::string, cache_entry>::iterator erase(std::unordered_map<std::string, cache_entry>::iterator it);
+		void touch(cache_entry& entry);
+		void evict();
+
+		std::mutex m_mutex;
+		size_t m_max_size = 32 * 1024 * 1024;
+		size_t m_size = 0;
+		std::unordered_map<std::string, cache_entry> m_entries;
+		// most recently used first
+		std::list<std::string> m_lru;
+		std::atomic<uint64_t> m_nr_hits = 0;
+		std::atomic<uint64_t> m_nr_revalidations = 0;
+		std::atomic<uint64_t> m_nr_misses = 0;
+	};
+}
@@ -0,0 +1,182 @@
+#include "response_compression.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+namespace net
+{
+	namespace
+	{
+		std::string to_lower(std::string value)
+		{
+			std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			return value;
+		}
+
+		std::string trim(const std::string& value)
+		{
+			auto start = value.find_first_not_of(" \t");
+
+			if (start == std::string::npos)
+			{
+				return "";
+			}
+
+			return value.substr(start, value.find_last_not_of(" \t") - start + 1);
+		}
+
+		bool is_compressible_type(const std::string& content_type, const std::vector<std::string>& allowed_types)
+		{
+			auto type = to_lower(content_type);
+
+			return std::any_of(allowed_types.begin(), allowed_types.end(), [&type](const std::string& allowed) {
+				return type.compare(0, allowed.size(), to_lower(allowed)) == 0;
+				});
+		}
+
+		void add_vary(http_response& response)
+		{
+			auto vary = find_header_value(response, "Vary");
+
+			if (vary == std::nullopt)
+			{
+				response.set_header_value("Vary", "Accept-Encoding");
+			}
+			else if (to_lower(*vary).find("accept-encoding") == std::string::npos && trim(*vary) != "*")
+			{
+				response.set_header_value("Vary", *vary + ", Accept-Encoding");
+			}
+		}
+	}
+
+	std::optional<utile::gzip::format> negotiate_encoding(const std::string& accept_encoding)
+	{
+		std::optional<double> gzip_quality = std::nullopt;
+		std::optional<double> deflate_quality = std::nullopt;
+		std::optional<double> any_quality = std::nullopt;
+
+		std::istringstream iss(accept_encoding);
+		std::string item;
+
+		while (std::getline(iss, item, ','))
+		{
+			auto separator = item.find(';');
+			auto coding = to_lower(trim(item.substr(0, separator)));
+			double quality = 1.0;
+
+			if (separator != std::string::npos)
+			{
+				auto parameter = to_lower(trim(item.substr(separator + 1)));
+
+				if (parameter.compare(0, 2, "q=") == 0)
+				{
+					try
+					{
+						quality = std::stod(parameter.substr(2));
+					}
+					catch (...)
+					{
+						quality = 0.0;
+					}
+				}
+			}
+
+			if (coding == "gzip" || coding == "x-gzip")
+			{
+				gzip_quality = quality;
+			}
+			else if (coding == "deflate")
+			{
+				deflate_quality = quality;
+			}
+			else if (coding == "*")
+			{
+				any_quality = quality;
+			}
+		}
+
+		// codings not listed take the quality of *
+		auto gzip = gzip_quality.value_or(any_quality.value_or(0.0));
+		auto deflate = deflate_quality.value_or(any_quality.value_or(0.0));
+
+		if (gzip > 0.0 && gzip >= deflate)
+		{
+			return utile::gzip::format::gzip;
+		}
+
+		if (deflate > 0.0)
+		{
+			return utile::gzip::format::zlib;
+		}
+
+		return std::nullopt;
+	}
+
+	std::optional<std::string> find_header_value(const ihttp_message& message, const std::string& name)
+	{
+		auto header = message.get_header();
+
+		if (!header.is_object())
+		{
+			return std::nullopt;
+		}
+
+		auto lower_name = to_lower(name);
+
+		for (const auto& item : header.items())
+		{
+			if (to_lower(item.key()) != lower_name)
+				continue;
+
+			if (item.value().is_string())
+				return item.value().get<std::string>();
+
+			if (item.value().is_number())
+				return std::to_string(item.value().get<long long>());
+		}
+
+		return std::nullopt;
+	}
+
+	void compress_response(const http_request& request, http_response& response, const compression_options& options)
+	{
+		if (response.get_status() < 200 || response.get_status() == 204 || response.get_status() == 304)
+		{
+			return;
+		}
+
+		if (find_header_value(response, "Content-Encoding") != std::nullopt)
+		{
+			return;
+		}
+
+		if (auto cache_control = find_header_value(response, "Cache-Control"); cache_control && to_lower(*cache_control).find("no-transform") != std::string::npos)
+		{
+			return;
+		}
+
+		auto content_type = find_header_value(response, "Content-Type");
+
+		if (response.get_body_size() < std::max<size_t>(options.m_min_size, 1) || content_type == std::nullopt || !is_compressible_type(*content_type, options.m_content_types))
+		{
+			return;
+		}
+
+		add_vary(response);
+
+		auto accept_encoding = find_header_value(request, "Accept-Encoding");
+
+		if (accept_encoding == std::nullopt)
+		{
+			return;
+		}
+
+		if (auto encoding = negotiate_encoding(*accept_encoding); encoding != std::nullopt)
+		{
+			const bool parallel = options.m_parallel_min_size != 0 && response.get_body_size() >= options.m_parallel_min_size;
+
+			response.compress_body(*encoding, options.m_level, parallel ? options.m_nr_parallel_threads : 1);
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "http_request.hpp"
+#include "http_response.hpp"
+
+#include "../utile/gzip_helpers.hpp"
+
+namespace net
+{
+	struct compression_options
+	{
+		// smaller bodies gain less than the compression costs
+		size_t m_min_size = 1024;
+		int m_level = utile::gzip::DEFAULT_LEVEL;
+		// matched against the start of the response's Content-Type, "text/" covers every text type
+		std::vector<std::string> m_content_types = { "text/", "application/json", "application/javascript", "application/xml", "image/svg+xml" };
+		// bodies at least this large are compressed on m_nr_parallel_threads threads (0 for one per core), 0 turns it off
+		size_t m_parallel_min_size = 0;
+		size_t m_nr_parallel_threads = 0;
+	};
+
+	// best encoding the Accept-Encoding value allows, gzip before deflate, nullopt for identity
+	std::optional<utile::gzip::format> negotiate_encoding(const std::string& accept_encoding);
+
+	// header names are compared without case, http/2 requests carry them in lowercase
+	std::optional<std::string> find_header_value(const ihttp_message& message, const std::string& name);
+
+	// compresses the body when the client accepts it and the response qualifies, responses the handler
+	// already encoded are left alone; responses that could be compressed get Vary: Accept-Encoding either way
+	void compress_response(const http_request& request, http_response& response, const compression_options& options);
+}
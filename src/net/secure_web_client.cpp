@@ -4,9 +4,23 @@ namespace net
 {
 	secure_web_client::secure_web_client(const std::vector<std::string>& pem_files, const std::function<bool(bool, boost::asio::ssl::verify_context& ctx)>& verify_certificate_callback) :
 		base_web_client(),
-		m_ssl_context(boost::asio::ssl::context::tlsv12_client),
+		m_ssl_context(boost::asio::ssl::context::tls_client),
 		m_verify_certificate_callback(verify_certificate_callback),
 		m_resolver(m_io_service)
+	{
+		initialize(pem_files);
+	}
+
+	secure_web_client::secure_web_client(boost::asio::io_context& io_context, const std::vector<std::string>& pem_files, const std::function<bool(bool, boost::asio::ssl::verify_context& ctx)>& verify_certificate_callback) :
+		base_web_client(io_context),
+		m_ssl_context(boost::asio::ssl::context::tls_client),
+		m_verify_certificate_callback(verify_certificate_callback),
+		m_resolver(m_io_service)
+	{
+		initialize(pem_files);
+	}
+
+	void secure_web_client::initialize(const std::vector<std::string>& pem_files)
 	{
 		set_socket(std::make_shared<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>(
 			std::move(boost::asio::ssl::stream<boost::asio::ip::tcp::socket>(m_io_service, m_ssl_context))));
@@ -14,6 +28,9 @@ namespace net
 		m_ssl_context.set_default_verify_paths();
 		m_ssl_context.set_verify_mode(boost::asio::ssl::verify_peer);
 
+		tls_session_cache::enable(m_ssl_context);
+		apply_tls_options(m_ssl_context, tls_options());
+
 		for (const auto& pem_file : pem_files)
 			m_ssl_context.load_verify_file(pem_file);
 
@@ -37,6 +54,14 @@ namespace net
 			m_ssl_context.load_verify_file(pem_file);
 	}
 
+	void secure_web_client::set_tls_options(const tls_options& tls)
+	{
+		apply_tls_options(m_ssl_context, tls);
+
+		// the ssl object of the stream built in advance copied the previous settings
+		m_stream_used = true;
+	}
+
 	bool secure_web_client::connect(const std::string& url, const  std::optional<std::string>& port) noexcept try
 	{
 		{
@@ -54,18 +79,29 @@ namespace net
 			string_port = *port;
 		}
 
-		boost::asio::ip::tcp::resolver::query query(url, string_port);
-		boost::asio::connect(m_socket->lowest_layer(), m_resolver.resolve(query));
-		m_socket->lowest_layer().set_option(boost::asio::ip::tcp::no_delay(true));
+		if (auto err = connect_tcp(m_resolver, url, string_port, [this, &url, &string_port]() { prepare_stream(url, string_port); }); !err)
+		{
+			std::cerr << "Failed to connect to server, err: " << err.message();
+			return false;
+		}
 
 		if (m_verify_certificate_callback == nullptr)
 		{
 			m_ssl_context.set_verify_callback(boost::asio::ssl::rfc2818_verification(url));
 		}
 
-		m_socket->handshake(boost::asio::ssl::stream<boost::asio::ip::tcp::socket>::client);
+		boost::system::error_code errcode;
+		m_socket->handshake(boost::asio::ssl::stream<boost::asio::ip::tcp::socket>::client, errcode);
+
+		on_handshake_completed(!errcode);
+
+		if (errcode)
+		{
+			throw boost::system::system_error(errcode);
+		}
 
 		m_host = url;
+		set_connection_data(url, string_port);
 
 		return true;
 	}
@@ -75,4 +111,64 @@ namespace net
 		return false;
 	}
 
+	void secure_web_client::async_connect(const std::string& url, const std::optional<std::string>& port, const async_connect_callback& callback, const uint16_t timeout) noexcept
+	{
+		std::string string_port = port != std::nullopt ? *port : "https";
+
+		async_connect_tcp(m_resolver, url, string_port, callback, timeout, [this, url, string_port]() { prepare_stream(url, string_port); }, [this, url, string_port](std::shared_ptr<connect_attempt> attempt) {
+			if (m_verify_certificate_callback == nullptr)
+			{
+				m_ssl_context.set_verify_callback(boost::asio::ssl::rfc2818_verification(url));
+			}
+
+			m_socket->async_handshake(boost::asio::ssl::stream<boost::asio::ip::tcp::socket>::client, [this, attempt, url, string_port](const boost::system::error_code& error) {
+				if (is_finished(attempt))
+				{
+					return;
+				}
+
+				on_handshake_completed(!error);
+
+				if (error)
+				{
+					finish_connect_attempt(attempt, utile::web_error(std::error_code(error.value(), std::generic_category()), error.message()));
+					return;
+				}
+
+				m_host = url;
+				set_connection_data(url, string_port);
+
+				finish_connect_attempt(attempt, utile::web_error());
+				});
+			});
+	}
+
+	void secure_web_client::prepare_stream(const std::string& url, const std::string& port)
+	{
+		// an ssl stream can't handshake again once it was used, a new one can also be handed a cached session
+		if (m_stream_used)
+		{
+			set_socket(std::make_shared<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>(m_io_service, m_ssl_context));
+		}
+
+		m_stream_used = true;
+		m_session_key = tls_session_cache::build_key(url, port);
+
+		boost::system::error_code errcode;
+		boost::asio::ip::make_address(url, errcode);
+
+		// server name indication, not allowed for ip addresses
+		if (errcode)
+		{
+			SSL_set_tlsext_host_name(m_socket->native_handle(), url.c_str());
+		}
+
+		tls_session_cache::get_instance().prepare(m_socket->native_handle(), m_session_key);
+	}
+
+	void secure_web_client::on_handshake_completed(const bool succeeded)
+	{
+		tls_session_cache::get_instance().on_handshake_completed(m_socket->native_handle(), m_session_key, succeeded);
+	}
+
 } // namespace net
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
 
 #include "base_web_client.hpp"
+#include "tls_options.hpp"
+#include "tls_session_cache.hpp"
 #include <boost/asio/ssl.hpp>
 
 namespace net
@@ -9,15 +11,26 @@ namespace net
 	{
 	public:
 		secure_web_client(const std::vector<std::string>& pem_files = {}, const std::function<bool(bool, boost::asio::ssl::verify_context& ctx)>& verify_certificate_callback = nullptr);
+		secure_web_client(boost::asio::io_context& io_context, const std::vector<std::string>& pem_files = {}, const std::function<bool(bool, boost::asio::ssl::verify_context& ctx)>& verify_certificate_callback = nullptr);
 		virtual ~secure_web_client() = default;
 		
 		void set_verify_certificate_callback(const std::function<bool(bool, boost::asio::ssl::verify_context& ctx)>& verify_certificate_callback);
 		void load_pem_files(const std::vector<std::string>& pem_files);
+		// version range and cipher profile, used from the next connect on
+		void set_tls_options(const tls_options& tls);
 		virtual bool connect(const std::string& url, const std::optional<std::string>& port = std::nullopt) noexcept override;
+		virtual void async_connect(const std::string& url, const std::optional<std::string>& port, const async_connect_callback& callback, const uint16_t timeout = 0) noexcept override;
 	private:
+		void initialize(const std::vector<std::string>& pem_files);
+		void prepare_stream(const std::string& url, const std::string& port);
+		void on_handshake_completed(const bool succeeded);
+
 		boost::asio::ssl::context m_ssl_context;
 		std::function<bool(bool, boost::asio::ssl::verify_context& ctx)> m_verify_certificate_callback;
 		boost::asio::ip::tcp::resolver m_resolver;
+		// host:port the current stream connects to, referenced by its ssl object
+		std::string m_session_key{};
+		bool m_stream_used = false;
 	};
 
 } // namespace net
\ No newline at end of file
@@ -1,20 +1,41 @@
 #include "secure_web_server.hpp"
 
+#include <cstring>
+
 namespace net
 {
+	namespace
+	{
+		constexpr size_t DEFAULT_SESSION_CACHE_SIZE = 20480;
+		constexpr std::chrono::seconds DEFAULT_SESSION_TIMEOUT{ 300 };
+
+		// sessions of other applications sharing the cache can't be resumed here
+		const unsigned char SESSION_ID_CONTEXT[] = "net::secure_web_server";
+
+		// ALPN wire format, length prefixed and in order of preference
+		const unsigned char HTTP2_PROTOCOLS[] = "\x02h2\x08http/1.1";
+		const unsigned char HTTP1_PROTOCOLS[] = "\x08http/1.1";
+	}
+
 	secure_web_server::secure_web_server(const utile::IP_ADRESS& host, const std::string& cert_file, 
 		const std::optional<std::string>& dh_file, const utile::PORT port,
-		const uint64_t max_nr_connections, const uint64_t number_threads) 
-		: base_web_server(host, port, max_nr_connections, number_threads) 
-		, m_ssl_context(boost::asio::ssl::context::tlsv12_server)
+		const uint64_t max_nr_connections, const uint64_t number_threads, const listener_options& options, const tls_options& tls) 
+		: base_web_server(host, port, max_nr_connections, number_threads, options) 
+		, m_ssl_context(boost::asio::ssl::context::tls_server)
 	{
 		m_build_client_socket_function = [this](boost::asio::io_context& context) {
-			return std::make_shared<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>(context, m_ssl_context);
+			// connections are closed without close_notify, openssl would drop their session from the cache otherwise;
+			// sessions of connections that failed with a fatal alert are still dropped
+			return std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>(new boost::asio::ssl::stream<boost::asio::ip::tcp::socket>(context, m_ssl_context),
+				[](boost::asio::ssl::stream<boost::asio::ip::tcp::socket>* stream) {
+					SSL_set_shutdown(stream->native_handle(), SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+					delete stream;
+				});
 		};
 
 		set_build_client_socket_function(m_build_client_socket_function);
 
-		m_handshake_function = std::bind(&secure_web_server::handshake, this, std::placeholders::_1, std::placeholders::_2);
+		m_handshake_function = std::bind(&secure_web_server::handshake, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3);
 
 		set_handshake_function(m_handshake_function);
 
@@ -24,6 +45,13 @@ namespace net
 		m_ssl_context.use_certificate_chain_file(cert_file);
 		m_ssl_context.use_private_key_file(cert_file, boost::asio::ssl::context::pem);
 
+		apply_tls_options(m_ssl_context, tls);
+
+		SSL_CTX_set_session_id_context(m_ssl_context.native_handle(), SESSION_ID_CONTEXT, sizeof(SESSION_ID_CONTEXT) - 1);
+		set_session_cache(DEFAULT_SESSION_CACHE_SIZE, DEFAULT_SESSION_TIMEOUT);
+		m_ticket_keys.install(m_ssl_context);
+		SSL_CTX_set_alpn_select_cb(m_ssl_context.native_handle(), &secure_web_server::on_alpn_select, this);
+
 		m_verify_certificate_callback = [](bool preverified, boost::asio::ssl::verify_context& ctx)
 			{
 				char subject_name[256];
@@ -36,6 +64,17 @@ namespace net
 
 		if (m_verify_certificate_callback)
 			m_ssl_context.set_verify_callback(m_verify_certificate_callback);
+
+		// last, every setup call above can throw and joinable threads must not be left behind then
+		start_handshake_threads(m_handshake_limits.m_nr_threads);
+	}
+
+	secure_web_server::~secure_web_server()
+	{
+		// no new handshakes once nothing is accepted anymore
+		stop();
+
+		stop_handshake_threads();
 	}
 
 	void secure_web_server::set_verify_certificate_callback(const std::function<bool(bool, boost::asio::ssl::verify_context& ctx)>& verify_certificate_callback)
@@ -46,22 +85,320 @@ namespace net
 		m_ssl_context.set_verify_callback(m_verify_certificate_callback);
 	}
 
-	void secure_web_server::handshake(std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> client_socket,
-		std::function<void(std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>)> callback)
+	void secure_web_server::set_tls_options(const tls_options& tls)
+	{
+		apply_tls_options(m_ssl_context, tls);
+	}
+
+	void secure_web_server::set_session_cache(const size_t max_entries, const std::chrono::seconds timeout)
+	{
+		auto context = m_ssl_context.native_handle();
+
+		SSL_CTX_set_session_cache_mode(context, max_entries == 0 ? SSL_SESS_CACHE_OFF : SSL_SESS_CACHE_SERVER);
+		SSL_CTX_sess_set_cache_size(context, static_cast<long>(max_entries));
+
+		// tickets expire with the sessions they carry
+		SSL_CTX_set_timeout(context, static_cast<long>(timeout.count()));
+	}
+
+	void secure_web_server::set_session_tickets(const bool enabled)
+	{
+		if (enabled)
+		{
+			m_ssl_context.clear_options(SSL_OP_NO_TICKET);
+		}
+		else
+		{
+			m_ssl_context.set_options(SSL_OP_NO_TICKET);
+		}
+	}
+
+	void secure_web_server::set_ticket_key_rotation(const std::chrono::seconds interval)
+	{
+		m_ticket_keys.set_rotation_interval(interval);
+	}
+
+	void secure_web_server::rotate_ticket_keys()
+	{
+		m_ticket_keys.rotate();
+	}
+
+	void secure_web_server::set_handshake_limits(const handshake_limits& limits)
+	{
+		assert(limits.m_nr_threads > 0 && limits.m_max_concurrent > 0);
+
+		bool restart_threads = false;
+
+		{
+			std::scoped_lock lock(m_handshake_mutex);
+
+			restart_threads = limits.m_nr_threads != m_handshake_limits.m_nr_threads;
+			m_handshake_limits = limits;
+		}
+
+		if (restart_threads)
+		{
+			stop_handshake_threads();
+			start_handshake_threads(limits.m_nr_threads);
+		}
+	}
+
+	void secure_web_server::enable_http2(const http2_settings& settings)
+	{
+		m_http2_settings = settings;
+		m_http2_enabled = true;
+	}
+
+	void secure_web_server::disable_http2()
+	{
+		m_http2_enabled = false;
+	}
+
+	tls_server_stats secure_web_server::get_tls_stats()
 	{
-		client_socket->async_handshake(boost::asio::ssl::stream<boost::asio::ip::tcp::socket>::handshake_type::server,
-			[client_socket, callback](const boost::system::error_code& err) {
-				if (!err) 
+		auto context = m_ssl_context.native_handle();
+
+		tls_server_stats rez;
+
+		rez.m_nr_full_handshakes = m_nr_full_handshakes;
+		rez.m_nr_resumed_handshakes = m_nr_resumed_handshakes;
+		rez.m_nr_failed_handshakes = m_nr_failed_handshakes;
+		rez.m_nr_cache_hits = static_cast<uint64_t>(SSL_CTX_sess_hits(context));
+		rez.m_nr_cache_misses = static_cast<uint64_t>(SSL_CTX_sess_misses(context));
+		rez.m_nr_cache_timeouts = static_cast<uint64_t>(SSL_CTX_sess_timeouts(context));
+		rez.m_nr_cache_full = static_cast<uint64_t>(SSL_CTX_sess_cache_full(context));
+		rez.m_nr_cached_sessions = static_cast<uint64_t>(SSL_CTX_sess_number(context));
+		rez.m_nr_ticket_key_rotations = m_ticket_keys.get_nr_rotations();
+		rez.m_nr_rejected_handshakes = m_nr_rejected_handshakes;
+		rez.m_nr_http2_connections = m_nr_http2_connections;
+
+		{
+			std::scoped_lock lock(m_handshake_mutex);
+
+			rez.m_nr_active_handshakes = m_nr_active_handshakes;
+			rez.m_nr_queued_handshakes = m_handshake_queue.size();
+		}
+
+		return rez;
+	}
+
+	void secure_web_server::handshake(std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> client_socket, const uint64_t client_id, connection_handle callback)
+	{
+		pending_handshake pending{ client_socket, client_id, callback };
+
+		{
+			std::scoped_lock lock(m_handshake_mutex);
+
+			if (m_nr_active_handshakes >= m_handshake_limits.m_max_concurrent)
+			{
+				if (m_handshake_queue.size() < m_handshake_limits.m_max_queued)
 				{
-					callback(client_socket);
-					err.value();
+					m_handshake_queue.push_back(std::move(pending));
+					return;
+				}
+
+				m_nr_rejected_handshakes++;
+				pending.m_socket = nullptr;
+			}
+			else
+			{
+				m_nr_active_handshakes++;
+			}
+		}
+
+		// rejected, dropping the socket closes the connection
+		if (pending.m_socket == nullptr)
+		{
+			release_connection_id(client_id);
+			return;
+		}
+
+		start_handshake(std::move(pending));
+	}
+
+	void secure_web_server::start_handshake(pending_handshake pending)
+	{
+		// the completion handler is bound to the strand, asio runs the ssl steps of the handshake (the expensive part) on its executor as well
+		auto strand = boost::asio::make_strand(m_handshake_context);
+		auto timeout = m_handshake_limits.m_timeout;
+
+		boost::asio::dispatch(strand, [this, strand, pending = std::move(pending), timeout]() {
+			std::shared_ptr<boost::asio::steady_timer> deadline = nullptr;
+			auto client_socket = pending.m_socket;
+
+			if (timeout.count() != 0)
+			{
+				deadline = std::make_shared<boost::asio::steady_timer>(strand, timeout);
+				deadline->async_wait([client_socket](const boost::system::error_code& error) {
+					if (!error)
+					{
+						boost::system::error_code ignored;
+						client_socket->lowest_layer().close(ignored);
+					}
+					});
+			}
+
+			client_socket->async_handshake(boost::asio::ssl::stream<boost::asio::ip::tcp::socket>::handshake_type::server,
+				boost::asio::bind_executor(strand, [this, pending, deadline](const boost::system::error_code& err) {
+					if (deadline)
+						deadline->cancel();
+
+					on_handshake_completed(pending, err);
+					}));
+			});
+	}
+
+	void secure_web_server::on_handshake_completed(pending_handshake pending, const boost::system::error_code& err)
+	{
+		auto& client_socket = pending.m_socket;
+
+		if (!err) 
+		{
+			if (SSL_session_reused(client_socket->native_handle()))
+				m_nr_resumed_handshakes++;
+			else
+				m_nr_full_handshakes++;
+
+			const unsigned char* protocol = nullptr;
+			unsigned int protocol_length = 0;
+
+			SSL_get0_alpn_selected(client_socket->native_handle(), &protocol, &protocol_length);
+
+			const bool use_http2 = protocol_length == 2 && std::memcmp(protocol, "h2", 2) == 0;
+
+			// the connection is served by the worker threads from now on
+			boost::asio::post(client_socket->get_executor(), [this, pending, use_http2]() {
+				if (use_http2)
+				{
+					start_http2_session(pending.m_socket, pending.m_id);
 				}
 				else
 				{
+					pending.m_callback(pending.m_socket, pending.m_id);
+				}
+				});
+		}
+		else
+		{
+			m_nr_failed_handshakes++;
+			release_connection_id(pending.m_id);
+
 #ifdef DEBUG
-					std::cerr << "Failed to establish handshake err: " << err.message() << std::endl;
+			std::cerr << "Failed to establish handshake err: " << err.message() << std::endl;
 #endif // DEBUG
-				}
-			});
+		}
+
+		pending_handshake next;
+
+		{
+			std::scoped_lock lock(m_handshake_mutex);
+
+			if (m_handshake_queue.empty())
+			{
+				m_nr_active_handshakes--;
+				return;
+			}
+
+			// the slot goes straight to the next connection
+			next = std::move(m_handshake_queue.front());
+			m_handshake_queue.pop_front();
+		}
+
+		start_handshake(std::move(next));
+	}
+
+	void secure_web_server::start_handshake_threads(const size_t nr_threads)
+	{
+		m_handshake_context.restart();
+		m_handshake_work.emplace(m_handshake_context.get_executor());
+
+		for (size_t it = 0; it < nr_threads; it++)
+		{
+			m_handshake_threads.emplace_back([this]() { m_handshake_context.run(); });
+		}
+	}
+
+	void secure_web_server::stop_handshake_threads()
+	{
+		m_handshake_work.reset();
+		m_handshake_context.stop();
+
+		for (auto& thread : m_handshake_threads)
+		{
+			if (thread.joinable())
+				thread.join();
+		}
+
+		m_handshake_threads.clear();
+	}
+
+	void secure_web_server::start_http2_session(std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> client_socket, const uint64_t client_id)
+	{
+		// an h2 connection holds its id like any other, until the session closes
+		if (!can_client_connect(client_socket))
+		{
+			release_connection_id(client_id);
+			return;
+		}
+
+		m_nr_http2_connections++;
+
+		auto handler = [this](std::shared_ptr<http_request> req) {
+			if (auto reply = route_request(req); reply != std::nullopt)
+			{
+				return std::move(*reply);
+			}
+
+			return http_response(400, "Bad Request");
+		};
+
+		auto on_closed = [this, client_socket, client_id]() {
+			on_client_disconnect(client_socket);
+
+			{
+				std::scoped_lock lock(m_http2_mutex);
+				m_http2_sessions.erase(client_socket.get());
+			}
+
+			release_connection_id(client_id);
+		};
+
+		auto session = std::make_shared<http2_session>(client_socket, m_http2_settings, handler, on_closed);
+
+		{
+			std::scoped_lock lock(m_http2_mutex);
+			m_http2_sessions.emplace(client_socket.get(), session);
+		}
+
+		on_client_connect(client_socket);
+		session->start();
+	}
+
+	void secure_web_server::on_server_stop() noexcept
+	{
+		std::scoped_lock lock(m_http2_mutex);
+
+		for (auto& [_, session] : m_http2_sessions)
+		{
+			session->close();
+		}
+
+		m_http2_sessions.clear();
+	}
+
+	int secure_web_server::on_alpn_select(SSL*, const unsigned char** out, unsigned char* out_length, const unsigned char* in, unsigned int in_length, void* arg)
+	{
+		auto server = static_cast<secure_web_server*>(arg);
+
+		const unsigned char* protocols = server->m_http2_enabled ? HTTP2_PROTOCOLS : HTTP1_PROTOCOLS;
+		const unsigned int protocols_length = static_cast<unsigned int>(server->m_http2_enabled ? sizeof(HTTP2_PROTOCOLS) - 1 : sizeof(HTTP1_PROTOCOLS) - 1);
+
+		// picks by the server's preference, a client offering neither goes on without ALPN
+		if (SSL_select_next_proto(const_cast<unsigned char**>(out), out_length, protocols, protocols_length, in, in_length) != OPENSSL_NPN_NEGOTIATED)
+		{
+			return SSL_TLSEXT_ERR_NOACK;
+		}
+
+		return SSL_TLSEXT_ERR_OK;
 	}
-}
+}
\ No newline at end of file
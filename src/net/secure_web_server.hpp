@@ -1,25 +1,126 @@
 #pragma once
 
 #include "base_web_server.hpp"
+#include "http2_session.hpp"
+#include "tls_options.hpp"
+#include "tls_ticket_keys.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <boost/asio/ssl.hpp>
 
 namespace net
 {
+	struct tls_server_stats
+	{
+		uint64_t m_nr_full_handshakes = 0;
+		uint64_t m_nr_resumed_handshakes = 0;
+		uint64_t m_nr_failed_handshakes = 0;
+		// resumption attempts as counted by openssl, by session id or ticket
+		uint64_t m_nr_cache_hits = 0;
+		uint64_t m_nr_cache_misses = 0;
+		uint64_t m_nr_cache_timeouts = 0;
+		// sessions dropped because the cache was full
+		uint64_t m_nr_cache_full = 0;
+		uint64_t m_nr_cached_sessions = 0;
+		uint64_t m_nr_ticket_key_rotations = 0;
+		uint64_t m_nr_active_handshakes = 0;
+		uint64_t m_nr_queued_handshakes = 0;
+		// connections closed because the handshake queue was full
+		uint64_t m_nr_rejected_handshakes = 0;
+		// connections that negotiated h2
+		uint64_t m_nr_http2_connections = 0;
+	};
+
+	// handshakes run on threads of their own so a reconnect storm can't take the worker threads away from established connections
+	struct handshake_limits
+	{
+		size_t m_nr_threads = 2;
+		// handshakes in progress at once, the next ones wait in a queue
+		size_t m_max_concurrent = 256;
+		// connections arriving while the queue is full are closed right away
+		size_t m_max_queued = 4096;
+		// a handshake still running after this is aborted, 0 for none
+		std::chrono::milliseconds m_timeout{ 10000 };
+	};
 
 	class secure_web_server : public base_web_server<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>
 	{
 	public:
-		secure_web_server(const utile::IP_ADRESS& host, const std::string& cert_file, const std::optional<std::string>& dh_file = std::nullopt, const utile::PORT port = 443, const uint64_t max_nr_connections = 1000, const uint64_t number_threads = 4);
-		virtual ~secure_web_server() = default;
+		secure_web_server(const utile::IP_ADRESS& host, const std::string& cert_file, const std::optional<std::string>& dh_file = std::nullopt, const utile::PORT port = 443, const uint64_t max_nr_connections = 1000, const uint64_t number_threads = 4, const listener_options& options = listener_options(),
+			const tls_options& tls = tls_options());
+		virtual ~secure_web_server();
 		
 		void set_verify_certificate_callback(const std::function<bool(bool, boost::asio::ssl::verify_context& ctx)>& verify_certificate_callback);
+
+		// version range and cipher profile, has to be set before start()
+		void set_tls_options(const tls_options& tls);
+
+		// session ids the server remembers so returning clients skip the full handshake, 0 entries disables the cache;
+		// these settings have to be made before start(), the socket for the next connection is built ahead of time
+		void set_session_cache(const size_t max_entries, const std::chrono::seconds timeout);
+		// on by default, the ticket keys only live in memory and are replaced every interval
+		void set_session_tickets(const bool enabled);
+		void set_ticket_key_rotation(const std::chrono::seconds interval);
+		void rotate_ticket_keys();
+
+		// has to be set before start()
+		void set_handshake_limits(const handshake_limits& limits);
+
+		// offers h2 over ALPN next to http/1.1, has to be set before start()
+		void enable_http2(const http2_settings& settings = http2_settings());
+		void disable_http2();
+
+		tls_server_stats get_tls_stats();
+	protected:
+		virtual void on_server_stop() noexcept override;
 	private:
-		void handshake(std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> client_socket, std::function<void(std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>)> callback);
+		// the connection id reserved when it was accepted travels with it, a dropped connection gives it back
+		struct pending_handshake
+		{
+			std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> m_socket;
+			uint64_t m_id = 0;
+			connection_handle m_callback;
+		};
+
+		void handshake(std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> client_socket, const uint64_t client_id, connection_handle callback);
+		void start_handshake(pending_handshake pending);
+		void on_handshake_completed(pending_handshake pending, const boost::system::error_code& err);
+		void start_handshake_threads(const size_t nr_threads);
+		void stop_handshake_threads();
+		void start_http2_session(std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>> client_socket, const uint64_t client_id);
+
+		static int on_alpn_select(SSL*, const unsigned char** out, unsigned char* out_length, const unsigned char* in, unsigned int in_length, void* arg);
 
 		std::function<std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>(boost::asio::io_context&)> m_build_client_socket_function = nullptr;
-		std::function<void(std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>, std::function<void(std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>)>)> m_handshake_function = nullptr;
+		std::function<void(std::shared_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>>, const uint64_t, connection_handle)> m_handshake_function = nullptr;
+		// has to outlive the context using it
+		tls_ticket_keys m_ticket_keys;
 		boost::asio::ssl::context m_ssl_context;
 		std::function<bool(bool, boost::asio::ssl::verify_context& ctx)> m_verify_certificate_callback = nullptr;
+		std::atomic<uint64_t> m_nr_full_handshakes = 0;
+		std::atomic<uint64_t> m_nr_resumed_handshakes = 0;
+		std::atomic<uint64_t> m_nr_failed_handshakes = 0;
+		std::atomic<uint64_t> m_nr_rejected_handshakes = 0;
+
+		std::mutex m_handshake_mutex;
+		handshake_limits m_handshake_limits;
+		size_t m_nr_active_handshakes = 0;
+		std::deque<pending_handshake> m_handshake_queue;
+		boost::asio::io_context m_handshake_context;
+		std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> m_handshake_work;
+		std::vector<std::thread> m_handshake_threads;
+
+		std::atomic<bool> m_http2_enabled = false;
+		http2_settings m_http2_settings;
+		std::mutex m_http2_mutex;
+		std::map<boost::asio::ssl::stream<boost::asio::ip::tcp::socket>*, std::shared_ptr<http2_session>> m_http2_sessions;
+		std::atomic<uint64_t> m_nr_http2_connections = 0;
 	};
 }
@@ -0,0 +1,99 @@
+#include "tls_options.hpp"
+
+#include <stdexcept>
+
+namespace net
+{
+	namespace
+	{
+		struct profile_lists
+		{
+			const char* m_tls12_ciphers;
+			const char* m_tls13_ciphersuites;
+			const char* m_groups;
+		};
+
+		profile_lists get_profile_lists(const cipher_profile profile)
+		{
+			switch (profile)
+			{
+			case cipher_profile::modern:
+				return profile_lists{
+					"ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:"
+					"ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256",
+					"TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256",
+					"X25519:P-256:P-384" };
+			case cipher_profile::throughput:
+				return profile_lists{
+					"ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384:"
+					"ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305",
+					"TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256",
+					"X25519:P-256" };
+			case cipher_profile::low_power:
+				return profile_lists{
+					"ECDHE-ECDSA-CHACHA20-POLY1305:ECDHE-RSA-CHACHA20-POLY1305:ECDHE-ECDSA-AES128-GCM-SHA256:ECDHE-RSA-AES128-GCM-SHA256:"
+					"ECDHE-ECDSA-AES256-GCM-SHA384:ECDHE-RSA-AES256-GCM-SHA384",
+					"TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256:TLS_AES_256_GCM_SHA384",
+					"X25519:P-256" };
+			default:
+				// openssl's own defaults, the groups are left as they are
+				return profile_lists{
+					"DEFAULT",
+					"TLS_AES_256_GCM_SHA384:TLS_CHACHA20_POLY1305_SHA256:TLS_AES_128_GCM_SHA256",
+					nullptr };
+			}
+		}
+
+		int to_openssl_version(const tls_version version)
+		{
+			return version == tls_version::tls_1_3 ? TLS1_3_VERSION : TLS1_2_VERSION;
+		}
+	}
+
+	void apply_tls_options(boost::asio::ssl::context& context, const tls_options& options)
+	{
+		auto native_context = context.native_handle();
+
+		if (to_openssl_version(options.m_min_version) > to_openssl_version(options.m_max_version))
+		{
+			throw std::invalid_argument("Minimum TLS version is above the maximum one");
+		}
+
+		if (SSL_CTX_set_min_proto_version(native_context, to_openssl_version(options.m_min_version)) != 1 ||
+			SSL_CTX_set_max_proto_version(native_context, to_openssl_version(options.m_max_version)) != 1)
+		{
+			throw std::invalid_argument("Unsupported TLS version range");
+		}
+
+		auto lists = get_profile_lists(options.m_cipher_profile);
+
+		const char* tls12_ciphers = options.m_tls12_ciphers ? options.m_tls12_ciphers->c_str() : lists.m_tls12_ciphers;
+		const char* tls13_ciphersuites = options.m_tls13_ciphersuites ? options.m_tls13_ciphersuites->c_str() : lists.m_tls13_ciphersuites;
+		const char* groups = options.m_groups ? options.m_groups->c_str() : lists.m_groups;
+
+		if (SSL_CTX_set_cipher_list(native_context, tls12_ciphers) != 1)
+		{
+			throw std::invalid_argument("Invalid TLS 1.2 cipher list");
+		}
+
+		if (SSL_CTX_set_ciphersuites(native_context, tls13_ciphersuites) != 1)
+		{
+			throw std::invalid_argument("Invalid TLS 1.3 ciphersuite list");
+		}
+
+		if (groups && SSL_CTX_set1_groups_list(native_context, groups) != 1)
+		{
+			throw std::invalid_argument("Invalid key exchange group list");
+		}
+
+		// a server picks by its own order instead of the client's, ignored by clients
+		if (options.m_cipher_profile != cipher_profile::compatible || options.m_tls12_ciphers || options.m_tls13_ciphersuites)
+		{
+			context.set_options(SSL_OP_CIPHER_SERVER_PREFERENCE);
+		}
+		else
+		{
+			context.clear_options(SSL_OP_CIPHER_SERVER_PREFERENCE);
+		}
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#include <boost/asio/ssl.hpp>
+
+namespace net
+{
+	enum class tls_version
+	{
+		tls_1_2,
+		tls_1_3
+	};
+
+	enum class cipher_profile
+	{
+		// openssl's defaults
+		compatible,
+		// forward secret AEAD ciphers only
+		modern,
+		// AES-GCM first, fastest on CPUs with AES instructions
+		throughput,
+		// ChaCha20-Poly1305 first, for CPUs without AES instructions
+		low_power
+	};
+
+	struct tls_options
+	{
+		// the highest version both sides support is negotiated, TLS 1.3 saves a round trip on every full handshake
+		tls_version m_min_version = tls_version::tls_1_2;
+		tls_version m_max_version = tls_version::tls_1_3;
+		cipher_profile m_cipher_profile = cipher_profile::compatible;
+
+		// in openssl's syntax, override the lists of the profile
+		std::optional<std::string> m_tls12_ciphers = std::nullopt;
+		std::optional<std::string> m_tls13_ciphersuites = std::nullopt;
+		std::optional<std::string> m_groups = std::nullopt;
+	};
+
+	// throws std::invalid_argument if openssl rejects a version or list
+	void apply_tls_options(boost::asio::ssl::context& context, const tls_options& options);
+}
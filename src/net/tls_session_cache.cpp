@@ -0,0 +1,168 @@
+#include "tls_session_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <ctime>
+
+namespace net
+{
+	namespace
+	{
+		bool is_resumable(SSL_SESSION* session)
+		{
+			return SSL_SESSION_is_resumable(session) && static_cast<time_t>(SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session)) > std::time(nullptr);
+		}
+	}
+
+	tls_session_cache& tls_session_cache::get_instance()
+	{
+		static tls_session_cache instance;
+		return instance;
+	}
+
+	void tls_session_cache::enable(boost::asio::ssl::context& context)
+	{
+		// openssl's own cache is keyed by session id only, sessions are kept here by host:port instead
+		SSL_CTX_set_session_cache_mode(context.native_handle(), SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		SSL_CTX_sess_set_new_cb(context.native_handle(), &tls_session_cache::on_new_session);
+	}
+
+	void tls_session_cache::set_max_entries(const size_t max_entries)
+	{
+		assert(max_entries > 0);
+
+		std::scoped_lock lock(m_mutex);
+		m_max_entries = max_entries;
+	}
+
+	void tls_session_cache::invalidate(const std::string& host, const std::string& port)
+	{
+		std::scoped_lock lock(m_mutex);
+		m_entries.erase(build_key(host, port));
+	}
+
+	void tls_session_cache::clear()
+	{
+		std::scoped_lock lock(m_mutex);
+		m_entries.clear();
+	}
+
+	void tls_session_cache::prepare(SSL* ssl, const std::string& key)
+	{
+		SSL_set_ex_data(ssl, get_key_index(), const_cast<std::string*>(&key));
+
+		std::shared_ptr<SSL_SESSION> session = nullptr;
+
+		{
+			std::scoped_lock lock(m_mutex);
+
+			if (auto it = m_entries.find(key); it != m_entries.end())
+			{
+				if (is_resumable(it->second.m_session.get()))
+				{
+					session = it->second.m_session;
+				}
+				else
+				{
+					m_entries.erase(it);
+				}
+			}
+		}
+
+		if (session)
+		{
+			// a copy as well, the connection might get dropped without close_notify again
+			if (auto copy = SSL_SESSION_dup(session.get()); copy != nullptr)
+			{
+				SSL_set_session(ssl, copy);
+				SSL_SESSION_free(copy);
+			}
+		}
+	}
+
+	void tls_session_cache::on_handshake_completed(SSL* ssl, const std::string& key, const bool succeeded)
+	{
+		if (!succeeded)
+		{
+			// the server might have rejected the session itself, start over with a full handshake
+			std::scoped_lock lock(m_mutex);
+			m_entries.erase(key);
+			return;
+		}
+
+		if (SSL_session_reused(ssl))
+		{
+			m_nr_hits++;
+		}
+		else
+		{
+			m_nr_misses++;
+		}
+	}
+
+	uint64_t tls_session_cache::get_nr_hits() const noexcept
+	{
+		return m_nr_hits;
+	}
+
+	uint64_t tls_session_cache::get_nr_misses() const noexcept
+	{
+		return m_nr_misses;
+	}
+
+	void tls_session_cache::reset_counters() noexcept
+	{
+		m_nr_hits = 0;
+		m_nr_misses = 0;
+	}
+
+	std::string tls_session_cache::build_key(const std::string& host, const std::string& port)
+	{
+		return host + ":" + port;
+	}
+
+	int tls_session_cache::get_key_index()
+	{
+		static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+		return index;
+	}
+
+	int tls_session_cache::on_new_session(SSL* ssl, SSL_SESSION* session)
+	{
+		auto key = static_cast<std::string*>(SSL_get_ex_data(ssl, get_key_index()));
+
+		if (key != nullptr && is_resumable(session))
+		{
+			// a copy, openssl marks the original not resumable when the connection is dropped without close_notify
+			if (auto copy = SSL_SESSION_dup(session); copy != nullptr)
+			{
+				get_instance().store(*key, copy);
+			}
+		}
+
+		// openssl keeps ownership of the original
+		return 0;
+	}
+
+	void tls_session_cache::store(const std::string& key, SSL_SESSION* session)
+	{
+		std::scoped_lock lock(m_mutex);
+
+		if (m_entries.size() >= m_max_entries && m_entries.find(key) == m_entries.end())
+		{
+			// make room by dropping the session stored the longest ago
+			auto oldest = std::min_element(m_entries.begin(), m_entries.end(), [](const auto& left, const auto& right) {
+				return left.second.m_stored_at < right.second.m_stored_at;
+				});
+
+			m_entries.erase(oldest);
+		}
+
+		cache_entry entry;
+		entry.m_session = std::shared_ptr<SSL_SESSION>(session, SSL_SESSION_free);
+		entry.m_stored_at = std::chrono::steady_clock::now();
+
+		// tls 1.3 servers send several tickets, the last one wins
+		m_entries[key] = entry;
+	}
+}
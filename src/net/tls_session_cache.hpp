@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <boost/asio/ssl.hpp>
+
+namespace net
+{
+	// process wide cache of client TLS sessions keyed by host:port, a reconnect offers the last session
+	// (id or ticket) negotiated with that server so the handshake is abbreviated
+	class tls_session_cache
+	{
+	public:
+		static tls_session_cache& get_instance();
+
+		tls_session_cache(const tls_session_cache&) = delete;
+		tls_session_cache& operator=(const tls_session_cache&) = delete;
+
+		// has to be called once on a client context, sessions negotiated through it are stored in the cache
+		static void enable(boost::asio::ssl::context& context);
+
+		void set_max_entries(const size_t max_entries);
+
+		void invalidate(const std::string& host, const std::string& port);
+		void clear();
+
+		// to be called before the handshake, key has to outlive the ssl object
+		void prepare(SSL* ssl, const std::string& key);
+
+		// counts a hit if the cached session was resumed, a failed handshake drops the session
+		void on_handshake_completed(SSL* ssl, const std::string& key, const bool succeeded);
+
+		uint64_t get_nr_hits() const noexcept;
+		uint64_t get_nr_misses() const noexcept;
+		void reset_counters() noexcept;
+
+		static std::string build_key(const std::string& host, const std::string& port);
+
+	private:
+		tls_session_cache() = default;
+
+		struct cache_entry
+		{
+			std::shared_ptr<SSL_SESSION> m_session;
+			std::chrono::steady_clock::time_point m_stored_at;
+		};
+
+		static int get_key_index();
+		static int on_new_session(SSL* ssl, SSL_SESSION* session);
+
+		void store(const std::string& key, SSL_SESSION* session);
+
+		std::mutex m_mutex;
+		size_t m_max_entries = 1024;
+		std::map<std::string, cache_entry> m_entries;
+		std::atomic<uint64_t> m_nr_hits = 0;
+		std::atomic<uint64_t> m_nr_misses = 0;
+	};
+}
@@ -0,0 +1,182 @@
+#include "tls_ticket_keys.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#include <openssl/rand.h>
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
+
+namespace net
+{
+	namespace
+	{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		bool set_mac_key(EVP_MAC_CTX* mac_ctx, std::array<unsigned char, 32>& hmac_key)
+		{
+			char digest[] = "SHA256";
+
+			OSSL_PARAM params[] = {
+				OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, hmac_key.data(), hmac_key.size()),
+				OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, digest, 0),
+				OSSL_PARAM_construct_end()
+			};
+
+			return EVP_MAC_CTX_set_params(mac_ctx, params) == 1;
+		}
+#else
+		bool set_mac_key(HMAC_CTX* mac_ctx, std::array<unsigned char, 32>& hmac_key)
+		{
+			return HMAC_Init_ex(mac_ctx, hmac_key.data(), static_cast<int>(hmac_key.size()), EVP_sha256(), nullptr) == 1;
+		}
+#endif
+	}
+
+	tls_ticket_keys::tls_ticket_keys(const std::chrono::seconds rotation_interval, const size_t nr_keys)
+		: m_rotation_interval(rotation_interval)
+		, m_nr_keys(nr_keys)
+	{
+		assert(rotation_interval.count() > 0 && nr_keys > 0);
+
+		if (!add_key())
+		{
+			throw std::runtime_error("Failed to generate session ticket key");
+		}
+	}
+
+	void tls_ticket_keys::install(boost::asio::ssl::context& context)
+	{
+		SSL_CTX_set_ex_data(context.native_handle(), get_context_index(), this);
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		SSL_CTX_set_tlsext_ticket_key_evp_cb(context.native_handle(), &tls_ticket_keys::on_ticket);
+#else
+		SSL_CTX_set_tlsext_ticket_key_cb(context.native_handle(), &tls_ticket_keys::on_ticket);
+#endif
+	}
+
+	void tls_ticket_keys::set_rotation_interval(const std::chrono::seconds rotation_interval)
+	{
+		assert(rotation_interval.count() > 0);
+
+		std::scoped_lock lock(m_mutex);
+		m_rotation_interval = rotation_interval;
+	}
+
+	void tls_ticket_keys::rotate()
+	{
+		std::scoped_lock lock(m_mutex);
+
+		if (add_key())
+		{
+			m_nr_rotations++;
+		}
+	}
+
+	uint64_t tls_ticket_keys::get_nr_rotations() const noexcept
+	{
+		return m_nr_rotations;
+	}
+
+	uint64_t tls_ticket_keys::get_nr_unknown_keys() const noexcept
+	{
+		return m_nr_unknown_keys;
+	}
+
+	int tls_ticket_keys::get_context_index()
+	{
+		static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+		return index;
+	}
+
+	// 1 means the ticket key was set up, 2 that the ticket was decrypted but should be renewed, 0 that it's unknown
+	int tls_ticket_keys::on_ticket(SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher_ctx, mac_context* mac_ctx, int encrypt)
+	{
+		auto keys = static_cast<tls_ticket_keys*>(SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), get_context_index()));
+
+		if (keys == nullptr)
+		{
+			return -1;
+		}
+
+		std::scoped_lock lock(keys->m_mutex);
+
+		keys->rotate_if_due();
+
+		if (encrypt)
+		{
+			auto& key = keys->m_keys.front();
+
+			if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) != 1)
+			{
+				return -1;
+			}
+
+			std::memcpy(key_name, key.m_name.data(), key.m_name.size());
+
+			if (EVP_EncryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), nullptr, key.m_aes_key.data(), iv) != 1 || !set_mac_key(mac_ctx, key.m_hmac_key))
+			{
+				return -1;
+			}
+
+			return 1;
+		}
+
+		auto it = std::find_if(keys->m_keys.begin(), keys->m_keys.end(), [key_name](const ticket_key& key) {
+			return std::memcmp(key.m_name.data(), key_name, key.m_name.size()) == 0;
+			});
+
+		if (it == keys->m_keys.end())
+		{
+			keys->m_nr_unknown_keys++;
+			return 0;
+		}
+
+		if (!set_mac_key(mac_ctx, it->m_hmac_key) || EVP_DecryptInit_ex(cipher_ctx, EVP_aes_256_cbc(), nullptr, it->m_aes_key.data(), iv) != 1)
+		{
+			return -1;
+		}
+
+		return it == keys->m_keys.begin() ? 1 : 2;
+	}
+
+	void tls_ticket_keys::rotate_if_due()
+	{
+		if (std::chrono::steady_clock::now() - m_keys.front().m_created_at < m_rotation_interval)
+		{
+			return;
+		}
+
+		// on failure the current key stays in use until the next handshake tries again
+		if (add_key())
+		{
+			m_nr_rotations++;
+		}
+	}
+
+	bool tls_ticket_keys::add_key()
+	{
+		ticket_key key;
+
+		if (RAND_bytes(key.m_name.data(), static_cast<int>(key.m_name.size())) != 1 ||
+			RAND_bytes(key.m_aes_key.data(), static_cast<int>(key.m_aes_key.size())) != 1 ||
+			RAND_bytes(key.m_hmac_key.data(), static_cast<int>(key.m_hmac_key.size())) != 1)
+		{
+			return false;
+		}
+
+		key.m_created_at = std::chrono::steady_clock::now();
+
+		m_keys.push_front(key);
+
+		while (m_keys.size() > m_nr_keys)
+		{
+			m_keys.pop_back();
+		}
+
+		return true;
+	}
+}
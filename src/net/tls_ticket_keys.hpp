@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+#include <boost/asio/ssl.hpp>
+
+#if OPENSSL_VERSION_NUMBER < 0x30000000L
+#include <openssl/hmac.h>
+#endif
+
+namespace net
+{
+	// session ticket keys of a server context, kept in memory only and never written anywhere;
+	// new tickets are encrypted with the newest key, which is replaced every rotation interval,
+	// tickets of the previous keys are still accepted and get renewed with the newest key
+	class tls_ticket_keys
+	{
+	public:
+		tls_ticket_keys(const std::chrono::seconds rotation_interval = std::chrono::hours(1), const size_t nr_keys = 3);
+
+		tls_ticket_keys(const tls_ticket_keys&) = delete;
+		tls_ticket_keys& operator=(const tls_ticket_keys&) = delete;
+
+		// has to be called once on a server context, the keys have to outlive it
+		void install(boost::asio::ssl::context& context);
+
+		void set_rotation_interval(const std::chrono::seconds rotation_interval);
+
+		// replaces the newest key right away, e.g. when a key might have leaked
+		void rotate();
+
+		uint64_t get_nr_rotations() const noexcept;
+		// tickets presented with a key that was already dropped, those clients do a full handshake
+		uint64_t get_nr_unknown_keys() const noexcept;
+
+	private:
+		// openssl 1.1 hands the ticket callback a HMAC_CTX, 3.0 an EVP_MAC_CTX
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		typedef EVP_MAC_CTX mac_context;
+#else
+		typedef HMAC_CTX mac_context;
+#endif
+
+		struct ticket_key
+		{
+			std::array<unsigned char, 16> m_name;
+			std::array<unsigned char, 32> m_aes_key;
+			std::array<unsigned char, 32> m_hmac_key;
+			std::chrono::steady_clock::time_point m_created_at;
+		};
+
+		static int get_context_index();
+		static int on_ticket(SSL* ssl, unsigned char* key_name, unsigned char* iv, EVP_CIPHER_CTX* cipher_ctx, mac_context* mac_ctx, int encrypt);
+
+		// has to be called with the lock held
+		void rotate_if_due();
+		bool add_key();
+
+		std::mutex m_mutex;
+		std::chrono::seconds m_rotation_interval;
+		const size_t m_nr_keys;
+		// newest first
+		std::deque<ticket_key> m_keys;
+		std::atomic<uint64_t> m_nr_rotations = 0;
+		std::atomic<uint64_t> m_nr_unknown_keys = 0;
+	};
+}
@@ -9,6 +9,11 @@ namespace net
 		set_socket(std::make_shared<boost::asio::ip::tcp::socket>(std::move(boost::asio::ip::tcp::socket(m_io_service))));
 	}
 
+	web_client::web_client(boost::asio::io_context& io_context) : base_web_client<boost::asio::ip::tcp::socket>(io_context), m_resolver(m_io_service)
+	{
+		set_socket(std::make_shared<boost::asio::ip::tcp::socket>(m_io_service));
+	}
+
 	bool web_client::connect(const std::string& url, const std::optional<std::string>& port) noexcept try
 	{
 		{
@@ -26,11 +31,14 @@ namespace net
 			string_port = *port;
 		}
 
-		boost::asio::ip::tcp::resolver::query query(url, string_port);
-		boost::asio::connect(m_socket->lowest_layer(), m_resolver.resolve(query));
-		m_socket->lowest_layer().set_option(boost::asio::ip::tcp::no_delay(true));
+		if (auto err = connect_tcp(m_resolver, url, string_port, nullptr); !err)
+		{
+			std::cerr << "Failed to connect to server, err: " << err.message();
+			return false;
+		}
 
 		m_host = url;
+		set_connection_data(url, string_port);
 
 		return true;
 	}
@@ -39,4 +47,16 @@ namespace net
 		std::cerr << "Failed to connect to server, err: " << err.what();
 		return false;
 	}
+
+	void web_client::async_connect(const std::string& url, const std::optional<std::string>& port, const async_connect_callback& callback, const uint16_t timeout) noexcept
+	{
+		std::string string_port = port != std::nullopt ? *port : "http";
+
+		async_connect_tcp(m_resolver, url, string_port, callback, timeout, nullptr, [this, url, string_port](std::shared_ptr<connect_attempt> attempt) {
+			m_host = url;
+			set_connection_data(url, string_port);
+
+			finish_connect_attempt(attempt, utile::web_error());
+			});
+	}
 } // namespace net
\ No newline at end of file
@@ -8,8 +8,10 @@ namespace net
 	{
 	public:
 		web_client();
+		web_client(boost::asio::io_context& io_context);
 		virtual ~web_client() = default;
 		virtual bool connect(const std::string& url, const std::optional<std::string>& port = std::nullopt) noexcept override;
+		virtual void async_connect(const std::string& url, const std::optional<std::string>& port, const async_connect_callback& callback, const uint16_t timeout = 0) noexcept override;
 
 	private:
 		boost::asio::ip::tcp::resolver m_resolver;
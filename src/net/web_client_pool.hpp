@@ -0,0 +1,908 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "base_web_client.hpp"
+#include "request_policy.hpp"
+
+namespace net
+{
+	struct batch_request
+	{
+		std::string m_host{};
+		std::string m_port{};
+		http_request m_request;
+	};
+
+	struct batch_result
+	{
+		std::shared_ptr<http_response> m_response = nullptr;
+		utile::web_error m_error;
+	};
+
+	// index is the position of the request in the batch
+	typedef std::function<void(const size_t index, const batch_result& result)> batch_result_callback;
+	typedef std::function<void(std::vector<batch_result>&& results)> batch_completed_callback;
+
+	// keeps keep-alive connections per host:port and spreads requests over them,
+	// requests over the per host limit wait in a queue for the next free connection
+	template <typename C>
+	class web_client_pool
+	{
+	public:
+		typedef std::function<std::unique_ptr<C>()> client_factory;
+
+		web_client_pool(const size_t max_connections_per_host = 8, const std::chrono::seconds max_idle_time = std::chrono::seconds(30), const client_factory& factory = nullptr)
+			: m_max_connections_per_host(max_connections_per_host)
+			, m_max_idle_time(max_idle_time)
+			, m_factory(factory)
+		{
+			assert(max_connections_per_host > 0);
+
+			if (!m_factory)
+			{
+				m_factory = []() { return std::make_unique<C>(); };
+			}
+
+			m_timer_idle_work.emplace(m_timer_context);
+			m_timer_thread = std::thread([this]() { m_timer_context.run(); });
+		}
+
+		web_client_pool(const web_client_pool&) = delete;
+		web_client_pool& operator=(const web_client_pool&) = delete;
+
+		virtual ~web_client_pool()
+		{
+			std::list<std::shared_ptr<connection>> connections;
+
+			{
+				std::scoped_lock lock(m_mutex);
+				m_stopping = true;
+			}
+
+			// pending hedges and backoffs are dropped
+			m_timer_idle_work.reset();
+			m_timer_context.stop();
+
+			if (m_timer_thread.joinable())
+				m_timer_thread.join();
+
+			{
+				std::scoped_lock lock(m_mutex);
+
+				for (auto& [_, entry] : m_hosts)
+				{
+					connections.splice(connections.end(), entry.m_connections);
+				}
+
+				connections.splice(connections.end(), m_retired_connections);
+				m_hosts.clear();
+			}
+
+			// clients join their io threads, has to happen without holding the lock
+			connections.clear();
+		}
+
+		// callback runs on the io thread of the connection that served the request, timeout applies to every attempt
+		void send_async(const std::string& host, const std::string& port, http_request&& request, const async_get_callback& callback, const uint16_t timeout = 0) noexcept
+		{
+			send_cancellable(host, port, std::move(request), callback, timeout, nullptr);
+		}
+
+		// must not be called from a callback of this pool, it would block the io thread waiting on itself
+		std::pair<std::shared_ptr<http_response>, utile::web_error> send(const std::string& host, const std::string& port, http_request&& request, const uint16_t timeout = 0)
+		{
+			auto promise = std::make_shared<std::promise<std::pair<std::shared_ptr<http_response>, utile::web_error>>>();
+			auto future = promise->get_future();
+
+			send_async(host, port, std::move(request), [promise](std::shared_ptr<ihttp_message> message, utile::web_error err) {
+				promise->set_value({ std::dynamic_pointer_cast<http_response>(message), err });
+				}, timeout);
+
+			return future.get();
+		}
+
+		// sends every request of the batch at once, spread over the pooled connections of their hosts;
+		// on_result runs as each request completes, possibly on several io threads at the same time, and on_completed once after all of them.
+		// requests without a response when the deadline passes complete with ETIMEDOUT: queued ones are dropped,
+		// the ones in flight time out on their connections and retries or hedges of them aren't sent anymore
+		void send_batch_async(std::vector<batch_request>&& requests, const std::chrono::milliseconds deadline, const batch_result_callback& on_result,
+			const batch_completed_callback& on_completed) noexcept
+		{
+			assert(deadline.count() > 0);
+
+			auto batch = std::make_shared<batch_state>();
+			batch->m_results.resize(requests.size());
+			batch->m_claimed.resize(requests.size(), false);
+			batch->m_nr_remaining = requests.size();
+			batch->m_on_result = on_result;
+			batch->m_on_completed = on_completed;
+
+			if (requests.empty())
+			{
+				if (on_completed) on_completed(std::move(batch->m_results));
+				return;
+			}
+
+			batch->m_deadline = std::make_shared<boost::asio::steady_timer>(m_timer_context, deadline);
+			batch->m_deadline->async_wait([this, batch](const boost::system::error_code& error) {
+				if (error)
+				{
+					// every request completed in time
+					return;
+				}
+
+				*batch->m_canceled = true;
+
+				for (size_t index = 0; index < batch->m_results.size(); index++)
+				{
+					complete_batch_entry(batch, index, { nullptr, utile::web_error(std::error_code(ETIMEDOUT, std::generic_category()), "Batch deadline exceeded") });
+				}
+				});
+
+			// stragglers already sent are cut off by their own timeout at about the same time
+			auto timeout = static_cast<uint16_t>(std::min<int64_t>(deadline.count(), std::numeric_limits<uint16_t>::max()));
+
+			for (size_t index = 0; index < requests.size(); index++)
+			{
+				auto& item = requests[index];
+
+				send_cancellable(item.m_host, item.m_port, std::move(item.m_request), [this, batch, index](std::shared_ptr<ihttp_message> message, utile::web_error err) {
+					complete_batch_entry(batch, index, { std::dynamic_pointer_cast<http_response>(message), err });
+					}, timeout, batch->m_canceled);
+			}
+		}
+
+		// results are in the order of the requests, must not be called from a callback of this pool
+		std::vector<batch_result> send_batch(std::vector<batch_request>&& requests, const std::chrono::milliseconds deadline)
+		{
+			auto promise = std::make_shared<std::promise<std::vector<batch_result>>>();
+			auto future = promise->get_future();
+
+			send_batch_async(std::move(requests), deadline, nullptr, [promise](std::vector<batch_result>&& results) {
+				promise->set_value(std::move(results));
+				});
+
+			return future.get();
+		}
+
+		// closes connections that stayed idle for longer than max_idle_time
+		void evict_idle_connections()
+		{
+			std::list<std::shared_ptr<connection>> removed_connections;
+
+			{
+				std::scoped_lock lock(m_mutex);
+
+				removed_connections.splice(removed_connections.end(), m_retired_connections);
+				remove_idle_connections(removed_connections);
+			}
+
+			release_connections(std::move(removed_connections));
+		}
+
+		size_t get_nr_connections(const std::string& host, const std::string& port)
+		{
+			std::scoped_lock lock(m_mutex);
+
+			if (auto it = m_hosts.find(build_key(host, port)); it != m_hosts.end())
+			{
+				return it->second.m_connections.size();
+			}
+
+			return 0;
+		}
+
+		size_t get_nr_queued_requests(const std::string& host, const std::string& port)
+		{
+			std::scoped_lock lock(m_mutex);
+
+			if (auto it = m_hosts.find(build_key(host, port)); it != m_hosts.end())
+			{
+				return it->second.m_queue.size();
+			}
+
+			return 0;
+		}
+
+		// retries failed idempotent requests with exponential backoff, disabled by default
+		void set_retry_policy(const retry_policy& policy)
+		{
+			assert(policy.m_max_attempts > 0);
+
+			std::scoped_lock lock(m_mutex);
+			m_retry_policy = policy;
+		}
+
+		// sends duplicates of idempotent requests that are slower than the hedging delay on other connections, the first response wins;
+		// disabled by default
+		void set_hedging_policy(const hedging_policy& policy)
+		{
+			std::scoped_lock lock(m_mutex);
+			m_hedging_policy = policy;
+		}
+
+		// shared by the retries and hedges of every host of this pool
+		retry_budget& get_retry_budget() noexcept
+		{
+			return m_retry_budget;
+		}
+
+		latency_tracker& get_latency_tracker() noexcept
+		{
+			return m_latency_tracker;
+		}
+
+		uint64_t get_nr_retries() const noexcept
+		{
+			return m_nr_retries;
+		}
+
+		uint64_t get_nr_hedges() const noexcept
+		{
+			return m_nr_hedges;
+		}
+
+	private:
+		struct pending_request
+		{
+			std::string m_host{};
+			std::string m_port{};
+			http_request m_request;
+			async_get_callback m_callback;
+			uint16_t m_timeout = 0;
+			std::shared_ptr<const std::atomic<bool>> m_canceled = nullptr;
+			// the client keeps references to the request and to this callback until it completes
+			async_get_callback m_completion;
+		};
+
+		struct connection
+		{
+			// kept alive while the client still references them, the previous one is
+			// the request whose completion might still be on the stack
+			std::shared_ptr<pending_request> m_in_flight = nullptr;
+			std::shared_ptr<pending_request> m_previous = nullptr;
+			std::chrono::steady_clock::time_point m_last_used = std::chrono::steady_clock::now();
+			bool m_busy = false;
+			// declared last so it is destroyed first, joining the io thread before the requests go away
+			std::unique_ptr<C> m_client = nullptr;
+		};
+
+		struct host_entry
+		{
+			std::list<std::shared_ptr<connection>> m_connections;
+			std::deque<std::shared_ptr<pending_request>> m_queue;
+		};
+
+		// a request sent under the retry and hedging policies, every attempt sends a copy of it
+		struct guarded_request
+		{
+			std::mutex m_mutex;
+			std::string m_host{};
+			std::string m_port{};
+			http_request m_request;
+			async_get_callback m_callback;
+			uint16_t m_timeout = 0;
+			std::shared_ptr<const std::atomic<bool>> m_canceled = nullptr;
+			retry_policy m_retry_policy;
+			hedging_policy m_hedging_policy;
+			bool m_may_retry = false;
+			bool m_may_hedge = false;
+			uint32_t m_nr_retries = 0;
+			uint32_t m_nr_hedges = 0;
+			uint32_t m_nr_outstanding = 0;
+			bool m_backing_off = false;
+			bool m_completed = false;
+			// outcome of the last failed attempt, reported if nothing succeeds
+			std::shared_ptr<ihttp_message> m_last_message = nullptr;
+			utile::web_error m_last_error;
+		};
+
+		struct batch_state
+		{
+			std::mutex m_mutex;
+			std::vector<batch_result> m_results;
+			// set once the result of the request is decided, whatever arrives later is dropped
+			std::vector<bool> m_claimed;
+			size_t m_nr_remaining = 0;
+			batch_result_callback m_on_result;
+			batch_completed_callback m_on_completed;
+			std::shared_ptr<std::atomic<bool>> m_canceled = std::make_shared<std::atomic<bool>>(false);
+			std::shared_ptr<boost::asio::steady_timer> m_deadline = nullptr;
+		};
+
+		static std::string build_key(const std::string& host, const std::string& port)
+		{
+			return host + ":" + port;
+		}
+
+		// like send_async, once canceled is set queued requests fail with ECANCELED instead of being sent and retries and hedges stop
+		void send_cancellable(const std::string& host, const std::string& port, http_request&& request, const async_get_callback& callback, const uint16_t timeout,
+			const std::shared_ptr<const std::atomic<bool>>& canceled) noexcept
+		{
+			auto policy_request = std::make_shared<guarded_request>();
+
+			{
+				std::scoped_lock lock(m_mutex);
+
+				policy_request->m_retry_policy = m_retry_policy;
+				policy_request->m_hedging_policy = m_hedging_policy;
+			}
+
+			const bool may_retry = policy_request->m_retry_policy.m_max_attempts > 1 && (request.is_idempotent() || policy_request->m_retry_policy.m_retry_non_idempotent);
+			const bool may_hedge = policy_request->m_hedging_policy.m_max_hedges > 0 && request.is_idempotent();
+
+			if (!may_retry && !may_hedge)
+			{
+				submit(host, port, std::move(request), callback, timeout, canceled);
+				return;
+			}
+
+			m_retry_budget.on_request();
+
+			policy_request->m_host = host;
+			policy_request->m_port = port;
+			policy_request->m_request = std::move(request);
+			policy_request->m_callback = callback;
+			policy_request->m_timeout = timeout;
+			policy_request->m_canceled = canceled;
+			policy_request->m_may_retry = may_retry;
+			policy_request->m_may_hedge = may_hedge;
+
+			start_attempt(policy_request);
+
+			if (may_hedge)
+			{
+				schedule_hedge(policy_request);
+			}
+		}
+
+		// sends the request once on a pooled connection, queued behind the per host limit
+		void submit(const std::string& host, const std::string& port, http_request&& request, const async_get_callback& callback, const uint16_t timeout,
+			const std::shared_ptr<const std::atomic<bool>>& canceled = nullptr) noexcept
+		{
+			if (canceled && *canceled)
+			{
+				if (callback) callback(nullptr, canceled_error());
+				return;
+			}
+
+			auto pending = std::make_shared<pending_request>();
+			pending->m_host = host;
+			pending->m_port = port;
+			pending->m_request = std::move(request);
+			pending->m_callback = callback;
+			pending->m_timeout = timeout;
+			pending->m_canceled = canceled;
+
+			std::shared_ptr<connection> conn = nullptr;
+			std::list<std::shared_ptr<connection>> removed_connections;
+
+			{
+				std::unique_lock lock(m_mutex);
+
+				if (m_stopping)
+				{
+					lock.unlock();
+
+					if (callback) callback(nullptr, INTERNAL_ERROR);
+					return;
+				}
+
+				removed_connections.splice(removed_connections.end(), m_retired_connections);
+				remove_idle_connections(removed_connections);
+
+				auto& entry = m_hosts[build_key(host, port)];
+
+				conn = checkout(entry, removed_connections);
+
+				if (conn == nullptr)
+				{
+					if (entry.m_connections.size() >= m_max_connections_per_host)
+					{
+						entry.m_queue.push_back(pending);
+						return;
+					}
+
+					conn = std::make_shared<connection>();
+					conn->m_busy = true;
+					entry.m_connections.push_back(conn);
+				}
+			}
+
+			release_connections(std::move(removed_connections));
+
+			if (conn->m_client == nullptr)
+			{
+				open_connection(conn, pending);
+				return;
+			}
+
+			dispatch(conn, pending);
+		}
+
+		// destroyed clients join their io threads, which can't happen under the lock nor on one of those threads;
+		// submit runs on them whenever a completion hands over the next request, so the timer thread does it
+		void release_connections(std::list<std::shared_ptr<connection>>&& connections) noexcept
+		{
+			if (connections.empty())
+			{
+				return;
+			}
+
+			boost::asio::post(m_timer_context, [connections = std::move(connections)]() mutable {
+				connections.clear();
+				});
+		}
+
+		// has to be called with the lock held
+		std::shared_ptr<connection> checkout(host_entry& entry, std::list<std::shared_ptr<connection>>& removed_connections)
+		{
+			for (auto it = entry.m_connections.begin(); it != entry.m_connections.end();)
+			{
+				auto conn = *it;
+
+				if (conn->m_busy)
+				{
+					it++;
+					continue;
+				}
+
+				if (!conn->m_client->is_connection_alive())
+				{
+					removed_connections.push_back(conn);
+					it = entry.m_connections.erase(it);
+					continue;
+				}
+
+				conn->m_busy = true;
+				return conn;
+			}
+
+			return nullptr;
+		}
+
+		// has to be called with the lock held
+		void remove_idle_connections(std::list<std::shared_ptr<connection>>& removed_connections)
+		{
+			auto now = std::chrono::steady_clock::now();
+
+			for (auto& [_, entry] : m_hosts)
+			{
+				for (auto it = entry.m_connections.begin(); it != entry.m_connections.end();)
+				{
+					if (!(*it)->m_busy && now - (*it)->m_last_used > m_max_idle_time)
+					{
+						removed_connections.push_back(*it);
+						it = entry.m_connections.erase(it);
+					}
+					else
+					{
+						it++;
+					}
+				}
+			}
+		}
+
+		// connects without blocking, the request is sent from the io thread of the new connection once it's up
+		void open_connection(std::shared_ptr<connection> conn, std::shared_ptr<pending_request> pending) noexcept
+		{
+			try
+			{
+				conn->m_client = m_factory();
+			}
+			catch (...)
+			{
+				conn->m_client = nullptr;
+			}
+
+			if (conn->m_client == nullptr)
+			{
+				fail_connection(conn, pending);
+				return;
+			}
+
+			// weak, the connection owns the client holding this callback
+			std::weak_ptr<connection> weak_conn = conn;
+
+			conn->m_client->async_connect(pending->m_host, pending->m_port, [this, weak_conn, pending](utile::web_error err) {
+				auto conn = weak_conn.lock();
+
+				if (conn == nullptr)
+				{
+					return;
+				}
+
+				if (!err)
+				{
+					fail_connection(conn, pending);
+					return;
+				}
+
+				dispatch(conn, pending);
+				}, pending->m_timeout);
+		}
+
+		// drops a connection that could not be opened and hands its slot to the next queued request
+		void fail_connection(std::shared_ptr<connection> conn, std::shared_ptr<pending_request> pending) noexcept
+		{
+			std::shared_ptr<pending_request> next = nullptr;
+			std::vector<std::shared_ptr<pending_request>> canceled;
+
+			{
+				std::scoped_lock lock(m_mutex);
+
+				auto& entry = m_hosts[build_key(pending->m_host, pending->m_port)];
+				entry.m_connections.remove(conn);
+
+				if (conn->m_client)
+				{
+					m_retired_connections.push_back(conn);
+				}
+
+				if (!m_stopping)
+				{
+					next = pop_queued(entry, canceled);
+				}
+			}
+
+			if (pending->m_callback)
+				pending->m_callback(nullptr, utile::web_error(std::error_code(ENOTCONN, std::generic_category()), "Failed to connect to " + build_key(pending->m_host, pending->m_port)));
+
+			fail_canceled(canceled);
+
+			if (next)
+			{
+				submit(next->m_host, next->m_port, std::move(next->m_request), next->m_callback, next->m_timeout, next->m_canceled);
+			}
+		}
+
+		void dispatch(std::shared_ptr<connection> conn, std::shared_ptr<pending_request> pending) noexcept
+		{
+			auto raw_conn = conn.get();
+
+			pending->m_completion = [this, raw_conn](std::shared_ptr<ihttp_message> message, utile::web_error err) {
+				on_request_completed(raw_conn, message, err);
+			};
+
+			conn->m_in_flight = pending;
+
+			conn->m_client->send_async(std::move(pending->m_request), pending->m_completion, pending->m_timeout);
+		}
+
+		void on_request_completed(connection* raw_conn, std::shared_ptr<ihttp_message> message, utile::web_error err) noexcept
+		{
+			std::shared_ptr<connection> conn = nullptr;
+			std::shared_ptr<pending_request> next = nullptr;
+			// keeps the completion currently on the stack alive even if the next request fails inline
+			std::shared_ptr<pending_request> pending = nullptr;
+			std::vector<std::shared_ptr<pending_request>> canceled;
+			async_get_callback callback;
+			bool reconnect = false;
+
+			{
+				std::scoped_lock lock(m_mutex);
+
+				pending = raw_conn->m_in_flight;
+
+				if (pending == nullptr)
+				{
+					return;
+				}
+
+				callback = pending->m_callback;
+
+				raw_conn->m_previous = std::move(raw_conn->m_in_flight);
+				raw_conn->m_last_used = std::chrono::steady_clock::now();
+
+				auto& entry = m_hosts[build_key(pending->m_host, pending->m_port)];
+
+				auto it = std::find_if(entry.m_connections.begin(), entry.m_connections.end(), [raw_conn](const auto& item) { return item.get() == raw_conn; });
+
+				if (it == entry.m_connections.end())
+				{
+					// pool is shutting down
+				}
+				else if (!err || !raw_conn->m_client->is_connection_alive() || is_connection_closed_by_server(message))
+				{
+					// this runs on the io thread of the client, the timer thread destroys it later
+					m_retired_connections.push_back(*it);
+					entry.m_connections.erase(it);
+
+					if (!m_stopping)
+					{
+						next = pop_queued(entry, canceled);
+						reconnect = next != nullptr;
+					}
+				}
+				else if (!m_stopping && (next = pop_queued(entry, canceled)) != nullptr)
+				{
+					conn = *it;
+				}
+				else
+				{
+					raw_conn->m_busy = false;
+				}
+			}
+
+			if (callback) callback(message, err);
+
+			fail_canceled(canceled);
+
+			if (next && reconnect)
+			{
+				submit(next->m_host, next->m_port, std::move(next->m_request), next->m_callback, next->m_timeout, next->m_canceled);
+			}
+			else if (next)
+			{
+				dispatch(conn, next);
+			}
+		}
+
+		void start_attempt(std::shared_ptr<guarded_request> request) noexcept
+		{
+			http_request attempt;
+
+			{
+				std::scoped_lock lock(request->m_mutex);
+
+				request->m_nr_outstanding++;
+				attempt = request->m_request;
+			}
+
+			auto started_at = std::chrono::steady_clock::now();
+
+			submit(request->m_host, request->m_port, std::move(attempt), [this, request, started_at](std::shared_ptr<ihttp_message> message, utile::web_error err) {
+				on_attempt_completed(request, started_at, message, err);
+				}, request->m_timeout, request->m_canceled);
+		}
+
+		void on_attempt_completed(std::shared_ptr<guarded_request> request, const std::chrono::steady_clock::time_point started_at, std::shared_ptr<ihttp_message> message, utile::web_error err) noexcept
+		{
+			bool succeeded = static_cast<bool>(err);
+
+			if (auto response = std::dynamic_pointer_cast<http_response>(message); succeeded && response != nullptr)
+			{
+				succeeded = request->m_retry_policy.m_retry_on_status.count(response->get_status()) == 0;
+			}
+
+			uint32_t retry = 0;
+
+			{
+				std::scoped_lock lock(request->m_mutex);
+
+				request->m_nr_outstanding--;
+
+				if (request->m_completed)
+				{
+					// another attempt won already
+					return;
+				}
+
+				if (!succeeded)
+				{
+					request->m_last_message = message;
+					request->m_last_error = err;
+
+					if (request->m_nr_outstanding > 0)
+					{
+						// a hedge is still running, it might succeed
+						return;
+					}
+
+					if (request->m_may_retry && request->m_nr_retries + 1 < request->m_retry_policy.m_max_attempts && !is_canceled(request->m_canceled) && m_retry_budget.try_spend())
+					{
+						retry = ++request->m_nr_retries;
+						request->m_backing_off = true;
+					}
+				}
+
+				if (retry == 0)
+				{
+					request->m_completed = true;
+				}
+			}
+
+			if (retry != 0)
+			{
+				m_nr_retries++;
+				schedule_retry(request, request->m_retry_policy.get_backoff(retry));
+				return;
+			}
+
+			if (succeeded)
+			{
+				m_latency_tracker.record(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started_at));
+			}
+			else
+			{
+				message = request->m_last_message;
+				err = request->m_last_error;
+			}
+
+			if (request->m_callback)
+				request->m_callback(message, err);
+		}
+
+		void schedule_retry(std::shared_ptr<guarded_request> request, const std::chrono::milliseconds backoff) noexcept
+		{
+			auto timer = std::make_shared<boost::asio::steady_timer>(m_timer_context, backoff);
+
+			timer->async_wait([this, timer, request](const boost::system::error_code& /*error*/) {
+				{
+					std::scoped_lock lock(request->m_mutex);
+
+					request->m_backing_off = false;
+
+					if (request->m_completed)
+					{
+						return;
+					}
+				}
+
+				start_attempt(request);
+
+				if (request->m_may_hedge)
+				{
+					schedule_hedge(request);
+				}
+				});
+		}
+
+		void schedule_hedge(std::shared_ptr<guarded_request> request) noexcept
+		{
+			auto delay = request->m_hedging_policy.m_delay;
+
+			if (request->m_hedging_policy.m_percentile != std::nullopt)
+			{
+				delay = m_latency_tracker.get_percentile(*request->m_hedging_policy.m_percentile).value_or(delay);
+			}
+
+			auto timer = std::make_shared<boost::asio::steady_timer>(m_timer_context, delay);
+
+			timer->async_wait([this, timer, request](const boost::system::error_code& error) {
+				if (error)
+				{
+					return;
+				}
+
+				{
+					std::scoped_lock lock(request->m_mutex);
+
+					if (request->m_completed || request->m_nr_hedges >= request->m_hedging_policy.m_max_hedges || is_canceled(request->m_canceled))
+					{
+						return;
+					}
+
+					// the backoff is there for a reason, the retry is sent once it's over
+					if (request->m_backing_off || !m_retry_budget.try_spend())
+					{
+						return;
+					}
+
+					request->m_nr_hedges++;
+				}
+
+				m_nr_hedges++;
+
+				start_attempt(request);
+				schedule_hedge(request);
+				});
+		}
+
+		void complete_batch_entry(std::shared_ptr<batch_state> batch, const size_t index, const batch_result& result) noexcept
+		{
+			{
+				std::scoped_lock lock(batch->m_mutex);
+
+				if (batch->m_claimed[index])
+				{
+					return;
+				}
+
+				batch->m_claimed[index] = true;
+				batch->m_results[index] = result;
+			}
+
+			if (batch->m_on_result)
+				batch->m_on_result(index, result);
+
+			{
+				std::scoped_lock lock(batch->m_mutex);
+
+				if (--batch->m_nr_remaining != 0)
+				{
+					return;
+				}
+			}
+
+			// the timer belongs to the timer thread, it's canceled there
+			boost::asio::post(m_timer_context, [timer = batch->m_deadline]() {
+				timer->cancel();
+				});
+
+			if (batch->m_on_completed)
+				batch->m_on_completed(std::move(batch->m_results));
+		}
+
+		// has to be called with the lock held, requests canceled while they waited are moved to canceled
+		static std::shared_ptr<pending_request> pop_queued(host_entry& entry, std::vector<std::shared_ptr<pending_request>>& canceled)
+		{
+			while (!entry.m_queue.empty())
+			{
+				auto next = entry.m_queue.front();
+				entry.m_queue.pop_front();
+
+				if (!is_canceled(next->m_canceled))
+				{
+					return next;
+				}
+
+				canceled.push_back(next);
+			}
+
+			return nullptr;
+		}
+
+		static void fail_canceled(const std::vector<std::shared_ptr<pending_request>>& canceled) noexcept
+		{
+			for (const auto& pending : canceled)
+			{
+				if (pending->m_callback)
+					pending->m_callback(nullptr, canceled_error());
+			}
+		}
+
+		static bool is_canceled(const std::shared_ptr<const std::atomic<bool>>& canceled) noexcept
+		{
+			return canceled != nullptr && *canceled;
+		}
+
+		static utile::web_error canceled_error()
+		{
+			return utile::web_error(std::error_code(ECANCELED, std::generic_category()), "Request canceled");
+		}
+
+		static bool is_connection_closed_by_server(const std::shared_ptr<ihttp_message>& message)
+		{
+			if (message == nullptr)
+			{
+				return false;
+			}
+
+			auto connection_status = message->get_header_value<std::string>("Connection");
+
+			return connection_status != std::nullopt && (*connection_status == "close" || *connection_status == "closed");
+		}
+
+		std::mutex m_mutex;
+		const size_t m_max_connections_per_host;
+		const std::chrono::seconds m_max_idle_time;
+		client_factory m_factory;
+		bool m_stopping = false;
+		std::map<std::string, host_entry> m_hosts;
+		std::list<std::shared_ptr<connection>> m_retired_connections;
+		retry_policy m_retry_policy;
+		hedging_policy m_hedging_policy;
+		retry_budget m_retry_budget;
+		latency_tracker m_latency_tracker;
+		std::atomic<uint64_t> m_nr_retries = 0;
+		std::atomic<uint64_t> m_nr_hedges = 0;
+		// runs the hedging and backoff timers
+		boost::asio::io_context m_timer_context;
+		std::optional<boost::asio::io_context::work> m_timer_idle_work;
+		std::thread m_timer_thread;
+	};
+} // namespace net
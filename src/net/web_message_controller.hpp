@@ -1,16 +1,22 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <optional>
 #include <set>
 
+#include "redirect_cache.hpp"
 #include "web_message_dispatcher.hpp"
 #include "web_message_reciever.hpp"
 
 #include "../utile/observer.hpp"
-#include "../utile/timer.hpp"
 #include "../utile/finally.hpp"
 
 namespace net
 {
+	// method path of the redirected request, where it was redirected and the redirect response
+	typedef std::function<void(const std::string&, const web_location&, std::shared_ptr<http_response>)> permanent_redirect_callback;
+
 	template <typename T>
 	class web_message_controller
 	{
@@ -19,18 +25,12 @@ namespace net
 			: m_socket(socket)
 			, m_dispatcher(m_socket)
 			, m_reciever(m_socket)
-			, m_cancel_timer(0)
+			, m_timeout_state(std::make_shared<timeout_state>())
 		{
-			m_base_timeout_callback = [this]()
+			if (m_socket)
 			{
-				if (this && m_socket->lowest_layer().is_open())
-				{
-					m_socket->lowest_layer().close();
-				}
-			};
-
-			m_base_timeout_observer = std::make_shared<utile::observer<>>(m_base_timeout_callback);
-			m_cancel_timer.subscribe(m_base_timeout_observer);
+				m_cancel_timer.emplace(m_socket->get_executor());
+			}
 		}
 
 		std::pair<std::shared_ptr<http_response>, utile::web_error> send(http_request&& request, const uint16_t timeout = 0, const bool should_follow_redirects = false) noexcept
@@ -39,32 +39,34 @@ namespace net
 
 			if (timeout)
 			{
-				m_cancel_timer.reset(timeout);
-				m_cancel_timer.resume();
+				start_cancel_timer(timeout);
 			}
 
-			auto pause_timer = [this]() { m_cancel_timer.pause(); };
-
 			if (auto err = m_dispatcher.send(request); !err)
 			{
+				stop_cancel_timer();
 				return { nullptr, err };
 			}
 
 			auto response = m_reciever.template get<http_response>();
 
-			if (should_follow_redirects && response.second && response.first && response.first->get_status() == 301)
+			auto time_left = stop_cancel_timer();
+
+			if (should_follow_redirects && response.second && response.first && redirect_cache::is_permanent_redirect(response.first->get_status()))
 			{
 				if (auto redirect_location = get_redirect_location(response.first); redirect_location != std::nullopt)
 				{
+					if (m_permanent_redirect_callback)
+						m_permanent_redirect_callback(request.get_method(), *redirect_location, response.first);
+
 					if (redirect_location.value().m_port != "" || redirect_location.value().m_host != "")
 					{
 						// redirection to another client is done by the client not by the controller
 						auto helper_err_data = redirect_location->to_json();
 
-						if (m_cancel_timer.is_running())
+						if (time_left)
 						{
-							m_cancel_timer.pause();
-							helper_err_data.emplace("remaining_time", m_cancel_timer.get_time_left());
+							helper_err_data.emplace("remaining_time", time_left);
 						}
 
 						return { response.first, utile::web_error(std::error_code(301, std::generic_category()), helper_err_data.dump()) };
@@ -72,7 +74,7 @@ namespace net
 
 					request.set_method(redirect_location.value().m_method);
 
-					return send(std::move(request), 0, should_follow_redirects);
+					return send(std::move(request), time_left, should_follow_redirects);
 				}
 			}
 
@@ -105,8 +107,7 @@ namespace net
 
 			if (timeout)
 			{
-				m_cancel_timer.reset(timeout);
-				m_cancel_timer.resume();
+				start_cancel_timer(timeout);
 			}
 
 			m_dispatcher.send_async(request, m_write_callback);
@@ -114,12 +115,14 @@ namespace net
 
 		void attach_timeout_observer(const std::shared_ptr<utile::observer<>>& obs)
 		{
-			m_cancel_timer.subscribe(obs);
+			std::scoped_lock lock(m_timeout_state->m_mutex);
+			m_timeout_state->m_observers.insert(obs);
 		}
 
 		void remove_observer(const std::shared_ptr<utile::observer<>>& obs)
 		{
-			m_cancel_timer.unsubscribe(obs);
+			std::scoped_lock lock(m_timeout_state->m_mutex);
+			m_timeout_state->m_observers.erase(obs);
 		}
 
 		std::pair<std::shared_ptr<http_request>, utile::web_error> get_request() noexcept
@@ -186,6 +189,9 @@ namespace net
 			m_socket = socket;
 			m_dispatcher.set_socket(m_socket);
 			m_reciever.set_socket(m_socket);
+
+			stop_cancel_timer();
+			m_cancel_timer.emplace(m_socket->get_executor());
 		}
 
 		bool can_send() const
@@ -193,12 +199,23 @@ namespace net
 			return m_can_send;
 		}
 
+		void set_content_decoding(const bool enabled) noexcept
+		{
+			m_reciever.set_content_decoding(enabled);
+		}
+
+		// invoked for every 301 and 308 followed
+		void set_permanent_redirect_callback(const permanent_redirect_callback& callback)
+		{
+			m_permanent_redirect_callback = callback;
+		}
+
 	private:
 		void get_response_post_async_send(utile::web_error err, http_request& request, async_get_callback& callback, const bool should_follow_redirects)
 		{
 			if (!err)
 			{
-				m_cancel_timer.pause();
+				stop_cancel_timer();
 
 				{
 					std::scoped_lock lock(m_mutex);
@@ -212,14 +229,17 @@ namespace net
 			m_get_callback = [this, &callback, &request, should_follow_redirects](std::shared_ptr<ihttp_message> message, utile::web_error err) {
 
 				auto response = std::dynamic_pointer_cast<http_response>(message);
-				if (should_follow_redirects && err && response && response->get_status() == 301)
+				if (should_follow_redirects && err && response && redirect_cache::is_permanent_redirect(response->get_status()))
 				{
 					if (auto redirect_location = get_redirect_location(message); redirect_location != std::nullopt)
 					{
+						if (m_permanent_redirect_callback)
+							m_permanent_redirect_callback(request.get_method(), *redirect_location, response);
+
 						if (redirect_location.value().m_port != "" || redirect_location.value().m_host != "")
 						{
 							// redirection to another client is done by the client not by the controller
-							m_cancel_timer.pause();
+							auto time_left = stop_cancel_timer();
 
 							{
 								std::scoped_lock lock(m_mutex);
@@ -228,15 +248,17 @@ namespace net
 
 							auto helper_err_data = redirect_location->to_json();
 
-							if (m_cancel_timer.is_running())
+							if (time_left)
 							{
-								m_cancel_timer.pause();
-								helper_err_data.emplace("remaining_time", m_cancel_timer.get_time_left());
+								helper_err_data.emplace("remaining_time", time_left);
 							}
 
 							callback(message, utile::web_error(std::error_code(301, std::generic_category()), helper_err_data.dump()));
+							return;
 						}
 
+						auto time_left = stop_cancel_timer();
+
 						request.set_method(redirect_location.value().m_method);
 
 						{ 
@@ -244,11 +266,12 @@ namespace net
 							m_can_send = true; 
 						}
 
-						send_async(std::move(request), callback, should_follow_redirects);
+						send_async(std::move(request), callback, time_left, should_follow_redirects);
+						return;
 					}
 				}
 
-				m_cancel_timer.pause();
+				stop_cancel_timer();
 
 				{
 					std::scoped_lock lock(m_mutex);
@@ -261,15 +284,107 @@ namespace net
 			m_reciever.template async_get<http_response>(m_get_callback);
 		}
 
+		// shared with the timer handler so a late expiry never touches a destroyed controller
+		struct timeout_state
+		{
+			std::mutex m_mutex;
+			uint64_t m_generation = 0;
+			bool m_running = false;
+			std::chrono::steady_clock::time_point m_deadline{};
+			std::set<std::shared_ptr<utile::observer<>>> m_observers;
+		};
+
+		// closes the socket once timeout milliseconds passed, runs on the executor of the socket instead of a thread of its own
+		void start_cancel_timer(const uint16_t timeout)
+		{
+			std::scoped_lock lock(m_timeout_state->m_mutex);
+
+			if (!m_cancel_timer)
+			{
+				return;
+			}
+
+			auto generation = ++m_timeout_state->m_generation;
+			m_timeout_state->m_running = true;
+			m_timeout_state->m_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+			m_cancel_timer->expires_at(m_timeout_state->m_deadline);
+			m_cancel_timer->async_wait([state = m_timeout_state, socket = std::weak_ptr<T>(m_socket), generation](const boost::system::error_code& error) {
+				if (error)
+				{
+					// canceled, the request finished in time
+					return;
+				}
+
+				on_cancel_timer_expired(state, socket, generation);
+				});
+		}
+
+		// returns the milliseconds left until the timeout, 0 if no timeout was set
+		uint16_t stop_cancel_timer()
+		{
+			std::scoped_lock lock(m_timeout_state->m_mutex);
+
+			if (!m_timeout_state->m_running)
+			{
+				return 0;
+			}
+
+			m_timeout_state->m_running = false;
+			m_timeout_state->m_generation++;
+
+			if (m_cancel_timer)
+			{
+				m_cancel_timer->cancel();
+			}
+
+			auto time_left = std::chrono::duration_cast<std::chrono::milliseconds>(m_timeout_state->m_deadline - std::chrono::steady_clock::now()).count();
+
+			// a request following a redirect that used the whole budget has to time out as well
+			return static_cast<uint16_t>(std::clamp<decltype(time_left)>(time_left, 1, UINT16_MAX));
+		}
+
+		static void on_cancel_timer_expired(std::shared_ptr<timeout_state> state, std::weak_ptr<T> weak_socket, const uint64_t generation)
+		{
+			std::set<std::shared_ptr<utile::observer<>>> observers;
+
+			{
+				std::scoped_lock lock(state->m_mutex);
+
+				if (!state->m_running || state->m_generation != generation)
+				{
+					// expired right as it was stopped or restarted
+					return;
+				}
+
+				state->m_running = false;
+				observers = state->m_observers;
+			}
+
+			if (auto socket = weak_socket.lock(); socket && socket->lowest_layer().is_open())
+			{
+				boost::system::error_code ignored;
+				// closing alone doesn't wake up a thread blocked in a synchronous read on linux
+				socket->lowest_layer().shutdown(boost::asio::socket_base::shutdown_both, ignored);
+				socket->lowest_layer().close(ignored);
+			}
+
+			for (auto& observer : observers)
+			{
+				observer->notify();
+			}
+		}
+
+		// has to be declared before the dispatcher and reciever, they hold a reference to it
+		std::shared_ptr<T> m_socket = nullptr;
 		web_message_dispatcher<T> m_dispatcher;
 		web_message_reciever<T> m_reciever;
-		std::shared_ptr<T> m_socket = nullptr;
-		std::function<void()> m_base_timeout_callback;
 		std::mutex m_mutex;
 		bool m_can_send = true;
-		utile::timer<> m_cancel_timer;
+		std::shared_ptr<timeout_state> m_timeout_state;
+		std::optional<boost::asio::steady_timer> m_cancel_timer;
 		async_send_callback m_write_callback;
 		async_get_callback m_get_callback;
-		std::shared_ptr<utile::observer<>> m_base_timeout_observer;
+		permanent_redirect_callback m_permanent_redirect_callback;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+
+#include "web_message_dispatcher.hpp"
+#include "web_message_reciever.hpp"
+
+namespace net
+{
+	struct pipelined_request
+	{
+		http_request m_request;
+		async_get_callback m_callback;
+		// set as soon as the write starts, the server might have processed it
+		bool m_written = false;
+		// requests are sent again only once after the connection broke
+		bool m_retried = false;
+	};
+
+	// requests still unanswered when the connection broke, oldest first
+	typedef std::function<void(std::deque<std::shared_ptr<pipelined_request>>, utile::web_error)> pipeline_broken_callback;
+
+	// writes requests back to back on one connection and matches responses to them in FIFO order (HTTP/1.1 pipelining)
+	template <typename T>
+	class web_message_pipeline
+	{
+	public:
+		web_message_pipeline(std::shared_ptr<T>& socket)
+			: m_socket(socket)
+			, m_dispatcher(m_socket)
+			, m_reciever(m_socket)
+		{
+			m_write_callback = std::bind(&web_message_pipeline::on_request_written, this, std::placeholders::_1);
+			m_read_callback = std::bind(&web_message_pipeline::on_response_recieved, this, std::placeholders::_1, std::placeholders::_2);
+		}
+
+		void send_async(std::shared_ptr<pipelined_request> request) noexcept
+		{
+			{
+				std::scoped_lock lock(m_mutex);
+				m_requests.push_back(request);
+			}
+
+			write_next_request();
+			read_next_response();
+		}
+
+		// 1 means a request is only written once the previous one got its response
+		void set_max_depth(const size_t max_depth)
+		{
+			assert(max_depth > 0);
+
+			std::scoped_lock lock(m_mutex);
+			m_max_depth = max_depth;
+		}
+
+		size_t get_max_depth()
+		{
+			std::scoped_lock lock(m_mutex);
+			return m_max_depth;
+		}
+
+		// invoked instead of the per request callbacks for requests that did not get a response
+		void set_pipeline_broken_callback(const pipeline_broken_callback& callback)
+		{
+			m_pipeline_broken_callback = callback;
+		}
+
+		bool empty()
+		{
+			std::scoped_lock lock(m_mutex);
+			return m_requests.empty();
+		}
+
+		void set_content_decoding(const bool enabled) noexcept
+		{
+			m_reciever.set_content_decoding(enabled);
+		}
+
+		void set_socket(std::shared_ptr<T>& socket)
+		{
+			m_socket = socket;
+			m_dispatcher.set_socket(m_socket);
+			m_reciever.set_socket(m_socket);
+		}
+
+	private:
+		void write_next_request() noexcept
+		{
+			std::shared_ptr<pipelined_request> request = nullptr;
+
+			{
+				std::scoped_lock lock(m_mutex);
+
+				if (m_writing || m_broken || m_nr_written >= m_requests.size() || m_nr_written >= m_max_depth)
+				{
+					return;
+				}
+
+				request = m_requests[m_nr_written];
+				request->m_written = true;
+				m_writing = true;
+			}
+
+			m_dispatcher.send_async(request->m_request, m_write_callback);
+		}
+
+		void read_next_response() noexcept
+		{
+			{
+				std::scoped_lock lock(m_mutex);
+
+				if (m_reading || m_broken || m_requests.empty())
+				{
+					return;
+				}
+
+				m_reading = true;
+			}
+
+			m_reciever.template async_get<http_response>(m_read_callback);
+		}
+
+		void on_request_written(utile::web_error err) noexcept
+		{
+			{
+				std::scoped_lock lock(m_mutex);
+				m_writing = false;
+
+				if (!err)
+				{
+					mark_broken(err);
+				}
+				else
+				{
+					m_nr_written++;
+				}
+			}
+
+			if (!err)
+			{
+				report_broken_pipeline();
+				return;
+			}
+
+			write_next_request();
+			// the connection might have been marked broken while this write was in flight
+			report_broken_pipeline();
+		}
+
+		void on_response_recieved(std::shared_ptr<ihttp_message> message, utile::web_error err) noexcept
+		{
+			std::shared_ptr<pipelined_request> request = nullptr;
+
+			{
+				std::scoped_lock lock(m_mutex);
+
+				m_reading = false;
+
+				if (!err)
+				{
+					mark_broken(err);
+				}
+				else if (m_nr_written == 0)
+				{
+					// a response nobody asked for, the connection can't be trusted anymore
+					mark_broken(utile::web_error(std::error_code(EPROTO, std::generic_category()), "Unexpected response recieved on pipelined connection"));
+				}
+				else
+				{
+					request = m_requests.front();
+					m_requests.pop_front();
+					m_nr_written--;
+				}
+			}
+
+			if (request == nullptr)
+			{
+				report_broken_pipeline();
+				return;
+			}
+
+			if (request->m_callback)
+				request->m_callback(message, err);
+
+			if (auto connection_status = message->get_header_value<std::string>("Connection"); connection_status != std::nullopt && *connection_status == "close")
+			{
+				{
+					// server drops every request written after this one
+					std::scoped_lock lock(m_mutex);
+					mark_broken(utile::web_error(std::error_code(ECONNRESET, std::generic_category()), "Connection closed by server"));
+				}
+
+				report_broken_pipeline();
+				return;
+			}
+
+			write_next_request();
+			read_next_response();
+			report_broken_pipeline();
+		}
+
+		// has to be called with the lock held
+		void mark_broken(utile::web_error err) noexcept
+		{
+			if (m_broken)
+			{
+				return;
+			}
+
+			m_broken = true;
+			m_broken_error = err;
+
+			// wakes up the pending read or write, both have to return before the requests are handed over
+			if (m_socket->lowest_layer().is_open())
+			{
+				boost::system::error_code ignored;
+				m_socket->lowest_layer().close(ignored);
+			}
+		}
+
+		void report_broken_pipeline() noexcept
+		{
+			std::deque<std::shared_ptr<pipelined_request>> unanswered;
+			utile::web_error err;
+
+			{
+				std::scoped_lock lock(m_mutex);
+
+				if (!m_broken || m_reported || m_writing || m_reading)
+				{
+					return;
+				}
+
+				m_reported = true;
+				m_nr_written = 0;
+				err = m_broken_error;
+				unanswered.swap(m_requests);
+			}
+
+			m_reciever.discard_buffered_data();
+
+			if (m_pipeline_broken_callback)
+			{
+				m_pipeline_broken_callback(std::move(unanswered), err);
+				return;
+			}
+
+			for (auto& request : unanswered)
+			{
+				if (request->m_callback)
+					request->m_callback(nullptr, err);
+			}
+
+			restart();
+		}
+
+	public:
+		// to be called once the connection was reestablished, the given requests are sent before the ones queued meanwhile
+		void restart(std::deque<std::shared_ptr<pipelined_request>> requests = {}) noexcept
+		{
+			{
+				std::scoped_lock lock(m_mutex);
+
+				m_requests.insert(m_requests.begin(), requests.begin(), requests.end());
+
+				m_broken = false;
+				m_reported = false;
+				m_nr_written = 0;
+			}
+
+			write_next_request();
+			read_next_response();
+		}
+
+	private:
+		// has to be declared before the dispatcher and reciever, they hold a reference to it
+		std::shared_ptr<T> m_socket = nullptr;
+		web_message_dispatcher<T> m_dispatcher;
+		web_message_reciever<T> m_reciever;
+		std::mutex m_mutex;
+		std::deque<std::shared_ptr<pipelined_request>> m_requests;
+		size_t m_nr_written = 0;
+		size_t m_max_depth = 1;
+		bool m_writing = false;
+		bool m_reading = false;
+		bool m_broken = false;
+		bool m_reported = false;
+		utile::web_error m_broken_error;
+		async_send_callback m_write_callback;
+		async_get_callback m_read_callback;
+		pipeline_broken_callback m_pipeline_broken_callback;
+	};
+}
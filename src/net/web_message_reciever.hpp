@@ -4,12 +4,15 @@
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 #include <boost/bind/bind.hpp>
+#include <charconv>
 #include <memory>
+#include <string_view>
 
 #include "http_request.hpp"
 #include "http_response.hpp"
 #include "../utile/generic_error.hpp"
 #include "../utile/finally.hpp"
+#include "../utile/gzip_helpers.hpp"
 
 namespace net
 {
@@ -18,6 +21,20 @@ namespace net
 	template <typename T>
 	class web_message_reciever
 	{
+		// compressed bytes read at once, bounds what is held besides the inflated body
+		static constexpr size_t DECODE_CHUNK_SIZE = 16384;
+		// longest chunk size or trailer line accepted in a chunked body
+		static constexpr size_t MAX_CHUNK_LINE_SIZE = 8192;
+
+		// where a chunked body stopped, its bytes arrive in arbitrary pieces
+		struct chunked_body_state
+		{
+			enum class step { size, data, data_end, trailers, done };
+
+			step m_step = step::size;
+			size_t m_remaining = 0;
+		};
+
 	public:
 		web_message_reciever() = delete;
 
@@ -51,8 +68,15 @@ namespace net
 				return { nullptr, utile::web_error(std::error_code(5, std::generic_category()), "Invalid message header recieved") };
 			}
 
+			start_body_decoding(response);
+
 			try_to_extract_body(response);
 
+			if (auto err = finish_body_decoding(response); !err)
+			{
+				return { nullptr, err };
+			}
+
 			response->finalize_message();
 
 			return { response, utile::web_error() };
@@ -93,9 +117,31 @@ namespace net
 			m_socket = socket;
 		}
 
+		// drops bytes read past the end of the last message, they are useless once the connection is gone
+		void discard_buffered_data()
+		{
+			m_request_buff.consume(m_request_buff.size());
+		}
+
+		// gzip and deflate bodies are inflated while they arrive, the message then looks as if it was sent uncompressed
+		void set_content_decoding(const bool enabled) noexcept
+		{
+			m_decode_content = enabled;
+		}
+
 	private:
 		void async_read(std::shared_ptr<ihttp_message> message, async_get_callback& callback) noexcept
 		{
+			if (m_request_buff.size() != 0)
+			{
+				// bytes of this message already read together with the previous one (pipelining)
+				std::istream source_stream(&m_request_buff);
+
+				std::ostream target_stream(&(message->get_buffer()));
+
+				target_stream << source_stream.rdbuf();
+			}
+
 			boost::asio::async_read_until(*m_socket, message->get_buffer(), "\r\n\r\n", [this, message, &callback](const boost::system::error_code& error, std::size_t /*bytes_transferred*/) {
 				if (error)
 				{
@@ -111,6 +157,7 @@ namespace net
 					}
 					else
 					{
+						start_body_decoding(message);
 						async_try_to_extract_body(message, callback);
 					}
 				}
@@ -133,6 +180,8 @@ namespace net
 			// remove already read characters from size of buffer;
 			*body_lenght -= static_cast<uint32_t>(message->get_buffer().size());
 
+			start_reading_body(message);
+
 			uint32_t available_bytes = 0;
 			do
 			{
@@ -140,15 +189,17 @@ namespace net
 
 				if (available_bytes >= *body_lenght)
 				{
-					boost::asio::read(*m_socket, message->get_buffer(), boost::asio::transfer_exactly(*body_lenght));
+					boost::asio::read(*m_socket, get_body_buffer(message), boost::asio::transfer_exactly(*body_lenght));
 					body_lenght.value() = 0;
 				}
 				else
 				{
 					*body_lenght -= available_bytes;
-					boost::asio::read(*m_socket, message->get_buffer(), boost::asio::transfer_exactly(available_bytes));
+					boost::asio::read(*m_socket, get_body_buffer(message), boost::asio::transfer_exactly(available_bytes));
 				}
 
+				decode_body_data(message);
+
 			} while (*body_lenght != 0);
 
 			return true;
@@ -177,47 +228,12 @@ namespace net
 
 			std::ostream ostream(&(message->get_buffer()));
 
-			bool should_read_size = true;
-			uint16_t buffer_size = 0;
+			m_chunked_state = chunked_body_state();
 
-			do
+			while (!decode_chunked_data(streambuf, ostream))
 			{
-				// search in streambuf for "\r\n", if found skip reading from socket
-
-				auto delimiter = find_delimiter_poz(streambuf, "\r\n");
-
-				if (delimiter == std::nullopt)
-				{
-					boost::asio::read_until(*m_socket, streambuf, "\r\n");
-				}
-
-				delimiter = find_delimiter_poz(streambuf, "\r\n");
-
-				if (delimiter == std::nullopt)
-				{
-					throw std::runtime_error("Failed to find delimiter, error occured when reading data");
-				}
-
-				if (!should_read_size)
-				{
-					if (*delimiter - 2 != buffer_size)
-					{
-						throw std::runtime_error("Invalid message body recieved, missing bytes: " + (buffer_size - (*delimiter - 1)));
-					}
-
-					copy_buffer_data_to_stream(ostream, streambuf, *delimiter);
-				}
-				else
-				{
-					copy_buffer_data_to_number(buffer_size, streambuf, *delimiter);
-				}
-
-				should_read_size = 1 - should_read_size;
-
-				streambuf.consume(*delimiter);
-
-			} while (buffer_size == 0 && should_read_size);
-
+				boost::asio::read(*m_socket, streambuf, boost::asio::transfer_at_least(1));
+			}
 
 			return true;
 		}
@@ -232,12 +248,16 @@ namespace net
 			}
 
 
+			start_reading_body(response);
+
 			std::size_t available_bytes = 0;
 			do
 			{
 				available_bytes = m_socket->lowest_layer().available();
 
-				boost::asio::read(*m_socket, response->get_buffer(), boost::asio::transfer_exactly(available_bytes));
+				boost::asio::read(*m_socket, get_body_buffer(response), boost::asio::transfer_exactly(available_bytes));
+
+				decode_body_data(response);
 
 			} while (available_bytes != 0);
 
@@ -252,7 +272,9 @@ namespace net
 			{
 				if (bytes_transferred > 0)
 				{
-					boost::asio::async_read(*m_socket, message->get_buffer(),
+					decode_body_data(message);
+
+					boost::asio::async_read(*m_socket, get_body_buffer(message),
 						boost::asio::transfer_at_least(1), // Read at least 1 byte
 						boost::bind(&web_message_reciever::async_read_all_remaining_data,
 							this,
@@ -265,9 +287,7 @@ namespace net
 				}
 				else
 				{
-					m_waiting_for_message = false;
-					message->finalize_message();
-					if (callback) callback(message, utile::web_error());
+					complete_message(message, callback);
 				}
 			}
 			else
@@ -281,13 +301,14 @@ namespace net
 		{
 			if (bytes_remaining == 0)
 			{
-				m_waiting_for_message = false;
-				message->finalize_message();
-				if (callback) callback(message, utile::web_error());
+				complete_message(message, callback);
 				return;
 			}
 
-			boost::asio::async_read(*m_socket, message->get_buffer(), boost::asio::transfer_at_least(1),
+			// compressed bodies are read piece by piece so each one is inflated as soon as it arrived
+			auto bytes_to_read = m_inflater ? std::min(bytes_remaining, DECODE_CHUNK_SIZE) : bytes_remaining;
+
+			boost::asio::async_read(*m_socket, get_body_buffer(message), boost::asio::transfer_exactly(bytes_to_read),
 				[this, &callback, message, bytes_remaining](const boost::system::error_code& error, std::size_t bytes_transferred) {
 					if (error)
 					{
@@ -296,6 +317,7 @@ namespace net
 					}
 					else
 					{
+						decode_body_data(message);
 						async_read_bytes(message, callback, bytes_remaining - bytes_transferred);
 					}
 				});
@@ -315,68 +337,55 @@ namespace net
 				return;
 			}
 
+			auto already_read = message->get_buffer().size();
+
+			if (already_read > *body_lenght)
+			{
+				// the rest belongs to the next message on this connection, keep it for the next read
+				keep_bytes_past_body(message, *body_lenght);
+				already_read = *body_lenght;
+			}
+
 			// remove already read characters from size of buffer;
-			*body_lenght -= message->get_buffer().size();
+			*body_lenght -= already_read;
+
+			start_reading_body(message);
 
 			std::size_t bytes_to_read = (*body_lenght);
 			async_read_bytes(message, callback, bytes_to_read);
 		}
 
-		void async_read_fragmented_body(std::shared_ptr<ihttp_message> message, async_get_callback& callback, bool should_read_size = true, uint16_t buffer_size = 0) noexcept
+		// the chunks are decoded from m_request_buff, whatever follows the trailers stays there for the next message
+		void async_read_fragmented_body(std::shared_ptr<ihttp_message> message, async_get_callback& callback) noexcept
 		{
-			do
+			try
 			{
-				// search in streambuf for "\r\n", if found skip reading from socket
-
-				auto delimiter = find_delimiter_poz(m_request_buff, "\r\n");
+				std::ostream ostream(&(message->get_buffer()));
 
-				if (delimiter == std::nullopt)
+				if (decode_chunked_data(m_request_buff, ostream))
 				{
-					boost::asio::async_read_until(*m_socket, m_request_buff, "\r\n", [this, &callback, message, should_read_size, buffer_size](const boost::system::error_code& error, std::size_t /*bytes_transferred*/) {
-						if (error)
-						{
-							m_waiting_for_message = false;
-							if (callback) callback(nullptr, utile::web_error(std::error_code(error.value(), std::generic_category()), "Failed to read enough data err: " + error.message()));
-						}
-						else
-						{
-							async_read_fragmented_body(message, callback, should_read_size, buffer_size);
-						}
-						});
+					complete_message(message, callback);
 					return;
 				}
+			}
+			catch (const std::exception& err)
+			{
+				m_waiting_for_message = false;
+				if (callback) callback(nullptr, utile::web_error(std::error_code(5, std::generic_category()), "Invalid fragmented body found err: " + std::string(err.what())));
+				return;
+			}
 
-				if (!should_read_size)
-				{
-					if (*delimiter - 2 != buffer_size)
-					{
-						if (callback) callback(nullptr, utile::web_error(std::error_code(5, std::generic_category()), "Invalid message body recieved, missing bytes: " + (buffer_size - (*delimiter - 1))));
-						return;
-					}
-
-					std::ostream ostream(&(message->get_buffer()));
-					copy_buffer_data_to_stream(ostream, m_request_buff, *delimiter);
-				}
-				else try
+			boost::asio::async_read(*m_socket, m_request_buff, boost::asio::transfer_at_least(1), [this, &callback, message](const boost::system::error_code& error, std::size_t /*bytes_transferred*/) {
+				if (error)
 				{
-					copy_buffer_data_to_number(buffer_size, m_request_buff, *delimiter);
+					m_waiting_for_message = false;
+					if (callback) callback(nullptr, utile::web_error(std::error_code(error.value(), std::generic_category()), "Failed to read enough data err: " + error.message()));
 				}
-				catch (const std::exception& err)
+				else
 				{
-					m_waiting_for_message = false;
-					if (callback) callback(nullptr, utile::web_error(std::error_code(-1, std::generic_category()), "Invalid fragmented body found err: " + std::string(err.what())));
-					return;
+					async_read_fragmented_body(message, callback);
 				}
-
-				should_read_size = 1 - should_read_size;
-
-				m_request_buff.consume(*delimiter);
-
-			} while (buffer_size == 0 && should_read_size);
-
-			m_waiting_for_message = false;
-			message->finalize_message();
-			if (callback) callback(message, utile::web_error());
+				});
 		}
 
 		void async_try_to_extract_body_using_transfer_encoding(std::shared_ptr<ihttp_message> message, async_get_callback& callback) noexcept
@@ -398,6 +407,8 @@ namespace net
 				target_stream << source_stream.rdbuf();
 			}
 
+			m_chunked_state = chunked_body_state();
+
 			async_read_fragmented_body(message, callback);
 		}
 
@@ -408,12 +419,13 @@ namespace net
 			if (connection_status == std::nullopt || connection_status.value() != "closed")
 			{
 				// no body found
-				m_waiting_for_message = false;
-				message->finalize_message();
-				if (callback) callback(message, utile::web_error());
+				complete_message(message, callback);
+				return;
 			}
 
-			boost::asio::async_read(*m_socket, message->get_buffer(),
+			start_reading_body(message);
+
+			boost::asio::async_read(*m_socket, get_body_buffer(message),
 				boost::asio::transfer_at_least(1), // Read at least 1 byte
 				boost::bind(&web_message_reciever::async_read_all_remaining_data,
 					this,
@@ -425,18 +437,220 @@ namespace net
 			);
 		}
 
-		void copy_buffer_data_to_stream(std::ostream& ostream, boost::asio::streambuf& streambuf, const size_t size)
+		void keep_bytes_past_body(std::shared_ptr<ihttp_message> message, const size_t body_lenght)
+		{
+			auto& buffer = message->get_buffer();
+
+			const char* data = boost::asio::buffer_cast<const char*>(buffer.data());
+
+			std::string body(data, body_lenght);
+			std::string leftover(data + body_lenght, buffer.size() - body_lenght);
+
+			buffer.consume(buffer.size());
+
+			std::ostream(&buffer) << body;
+			std::ostream(&m_request_buff) << leftover;
+		}
+
+		// consumes what input holds of a chunked body, true once the last chunk and the trailers went through
+		bool decode_chunked_data(boost::asio::streambuf& input, std::ostream& ostream)
+		{
+			auto& state = m_chunked_state;
+
+			while (state.m_step != chunked_body_state::step::done && input.size() != 0)
+			{
+				const char* data = boost::asio::buffer_cast<const char*>(input.data());
+
+				if (state.m_step == chunked_body_state::step::data)
+				{
+					auto size = std::min(state.m_remaining, input.size());
+
+					append_body_data(ostream, data, size);
+					input.consume(size);
+
+					state.m_remaining -= size;
+
+					if (state.m_remaining == 0)
+						state.m_step = chunked_body_state::step::data_end;
+
+					continue;
+				}
+
+				if (state.m_step == chunked_body_state::step::data_end)
+				{
+					if (input.size() < 2)
+						return false;
+
+					if (std::memcmp(data, "\r\n", 2) != 0)
+						throw std::runtime_error("chunk data longer than its size");
+
+					input.consume(2);
+					state.m_step = chunked_body_state::step::size;
+
+					continue;
+				}
+
+				auto delimiter = find_delimiter_poz(input, "\r\n");
+
+				if (delimiter == std::nullopt)
+				{
+					if (input.size() > MAX_CHUNK_LINE_SIZE)
+						throw std::runtime_error("chunk line too long");
+
+					return false;
+				}
+
+				if (state.m_step == chunked_body_state::step::size)
+				{
+					state.m_remaining = parse_chunk_size(std::string_view(data, *delimiter - 2));
+					state.m_step = state.m_remaining == 0 ? chunked_body_state::step::trailers : chunked_body_state::step::data;
+				}
+				else if (*delimiter == 2)
+				{
+					// the empty line closing the trailers
+					state.m_step = chunked_body_state::step::done;
+				}
+
+				input.consume(*delimiter);
+			}
+
+			return state.m_step == chunked_body_state::step::done;
+		}
+
+		// hex digits, chunk extensions after ';' are ignored
+		static size_t parse_chunk_size(std::string_view line)
+		{
+			line = line.substr(0, line.find(';'));
+
+			while (!line.empty() && (line.back() == ' ' || line.back() == '\t'))
+				line.remove_suffix(1);
+
+			size_t size = 0;
+			auto [end, err] = std::from_chars(line.data(), line.data() + line.size(), size, 16);
+
+			if (err != std::errc() || end != line.data() + line.size())
+				throw std::runtime_error("invalid chunk size: " + std::string(line));
+
+			return size;
+		}
+
+		void complete_message(std::shared_ptr<ihttp_message> message, async_get_callback& callback) noexcept
+		{
+			m_waiting_for_message = false;
+
+			if (auto err = finish_body_decoding(message); !err)
+			{
+				if (callback) callback(nullptr, err);
+				return;
+			}
+
+			message->finalize_message();
+			if (callback) callback(message, utile::web_error());
+		}
+
+		void start_body_decoding(const std::shared_ptr<ihttp_message>& message)
+		{
+			m_inflater = nullptr;
+			m_decode_error = utile::gzip_error();
+			m_encoded_buff.consume(m_encoded_buff.size());
+
+			if (!m_decode_content)
+			{
+				return;
+			}
+
+			if (auto encoding = message->get_header_value<std::string>("Content-Encoding"); encoding == "gzip" || encoding == "x-gzip" || encoding == "deflate")
+			{
+				m_inflater = std::make_unique<utile::gzip::inflater>();
+			}
+		}
+
+		// compressed bytes wait in m_encoded_buff until they are inflated into the message
+		boost::asio::streambuf& get_body_buffer(const std::shared_ptr<ihttp_message>& message)
 		{
-			const char* data = boost::asio::buffer_cast<const char*>(streambuf.data());
+			return m_inflater ? m_encoded_buff : message->get_buffer();
+		}
+
+		// the body bytes read together with the header have to be inflated as well
+		void start_reading_body(const std::shared_ptr<ihttp_message>& message)
+		{
+			if (!m_inflater || message->get_buffer().size() == 0)
+			{
+				return;
+			}
+
+			{
+				std::istream source_stream(&(message->get_buffer()));
+
+				std::ostream target_stream(&m_encoded_buff);
 
-			ostream << std::string(data, size - 2);
+				target_stream << source_stream.rdbuf();
+			}
+
+			decode_body_data(message);
 		}
 
-		void copy_buffer_data_to_number(uint16_t& buffer_size, boost::asio::streambuf& streambuf, const size_t size)
+		void decode_body_data(const std::shared_ptr<ihttp_message>& message)
 		{
-			const char* data = boost::asio::buffer_cast<const char*>(streambuf.data());
+			if (!m_inflater || m_encoded_buff.size() == 0)
+			{
+				return;
+			}
 
-			buffer_size = (uint16_t)std::stoll(std::string(data, size - 2));
+			std::ostream ostream(&(message->get_buffer()));
+
+			append_body_data(ostream, boost::asio::buffer_cast<const char*>(m_encoded_buff.data()), m_encoded_buff.size());
+
+			m_encoded_buff.consume(m_encoded_buff.size());
+		}
+
+		void append_body_data(std::ostream& ostream, const char* data, const size_t size)
+		{
+			if (!m_inflater)
+			{
+				ostream.write(data, size);
+			}
+			else if (m_decode_error)
+			{
+				// once the stream is corrupted the rest is only read to keep the connection usable
+				m_inflater->feed(reinterpret_cast<const uint8_t*>(data), size, ostream, m_decode_error);
+			}
+		}
+
+		// the decoded message loses its Content-Encoding so get_body_decrypted doesn't inflate it again
+		utile::web_error finish_body_decoding(const std::shared_ptr<ihttp_message>& message)
+		{
+			if (!m_inflater)
+			{
+				return utile::web_error();
+			}
+
+			auto inflater = std::move(m_inflater);
+
+			if (!m_decode_error)
+			{
+				return utile::web_error(std::error_code(5, std::generic_category()), "Invalid compressed message body recieved: " + m_decode_error.message());
+			}
+
+			if (inflater->get_nr_bytes_in() == 0)
+			{
+				// no body at all, e.g. the answer to a HEAD request
+				return utile::web_error();
+			}
+
+			if (!inflater->is_finished())
+			{
+				return utile::web_error(std::error_code(5, std::generic_category()), "Compressed message body ended too early");
+			}
+
+			message->remove_header_value("Content-Encoding");
+
+			if (message->get_header_value<size_t>("Content-Length") != std::nullopt)
+			{
+				message->set_header_value("Content-Length", message->get_buffer().size());
+			}
+
+			return utile::web_error();
 		}
 
 		std::optional<size_t> find_delimiter_poz(boost::asio::streambuf& buffer, const std::string& delimiter)
@@ -444,7 +658,10 @@ namespace net
 			const char* data = boost::asio::buffer_cast<const char*>(buffer.data());
 			std::size_t size = buffer.size();
 
-			std::optional<size_t> rez = std::nullopt;
+			if (size < delimiter.size())
+			{
+				return std::nullopt;
+			}
 
 			for (std::size_t i = 0; i < size - delimiter.size() + 1; ++i) {
 				if (std::memcmp(data + i, delimiter.c_str(), delimiter.size()) == 0) {
@@ -460,5 +677,10 @@ namespace net
 		std::atomic_bool m_waiting_for_message = false;
 		std::shared_ptr<T>& m_socket = nullptr;
 		boost::asio::streambuf m_request_buff;
+		bool m_decode_content = false;
+		std::unique_ptr<utile::gzip::inflater> m_inflater = nullptr;
+		utile::gzip_error m_decode_error;
+		boost::asio::streambuf m_encoded_buff;
+		chunked_body_state m_chunked_state;
 	};
 }
@@ -1,5 +1,12 @@
 #include "gzip_helpers.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
 #include "zlib.h"
 #include "finally.hpp"
 
@@ -7,96 +14,713 @@ namespace utile
 {
 	namespace gzip
 	{
-		std::vector<uint8_t> decompress(const std::vector<uint8_t>& compressed_data, gzip_error& err) noexcept {
-			std::vector<uint8_t> decompressed_data;
+		namespace
+		{
+			constexpr size_t INFLATE_BUFFER_SIZE = 16384;
+			// room added whenever an output vector runs full
+			constexpr size_t MIN_OUTPUT_GROWTH = 4096;
+			// compressed bodies usually inflate to a few times their size
+			constexpr size_t EXPECTED_RATIO = 4;
 
-			z_stream stream;
-			stream.zalloc = Z_NULL;
-			stream.zfree = Z_NULL;
-			stream.opaque = Z_NULL;
-			stream.avail_in = 0;
-			stream.next_in = Z_NULL;
+			struct context
+			{
+				z_stream m_stream{};
+				bool m_initialized = false;
+				bool m_deflate = false;
+				int m_level = 0;
+				format m_format = format::gzip;
+
+				~context()
+				{
+					if (!m_initialized)
+					{
+						return;
+					}
+
+					if (m_deflate)
+					{
+						deflateEnd(&m_stream);
+					}
+					else
+					{
+						inflateEnd(&m_stream);
+					}
+				}
+			};
+
+			// the ratio limit only applies to output past this
+			constexpr size_t RATIO_CHECK_MIN_OUTPUT = 1024 * 1024;
+			// deflate's window, what a block of compress_parallel is primed with
+			constexpr size_t DICTIONARY_SIZE = 32768;
+
+			int get_window_bits(const format output_format)
+			{
+				return output_format == format::gzip ? 16 + MAX_WBITS : MAX_WBITS;
+			}
+
+			// most output the limits allow for input_size bytes of input
+			size_t get_max_output(const decompression_limits& limits, const size_t input_size)
+			{
+				size_t rez = limits.m_max_size != 0 ? limits.m_max_size : std::numeric_limits<size_t>::max();
+
+				if (limits.m_max_ratio != 0 && input_size < std::numeric_limits<size_t>::max() / limits.m_max_ratio)
+				{
+					rez = std::min(rez, std::max(RATIO_CHECK_MIN_OUTPUT, input_size * limits.m_max_ratio));
+				}
+
+				return rez;
+			}
+
+			gzip_error make_limit_error()
+			{
+				return gzip_error(std::error_code(LIMIT_EXCEEDED, std::generic_category()), "Decompressed data exceeds the limits");
+			}
+
+			// another gzip member may follow the end of one (rfc 1952), zlib streams stand alone
+			bool is_gzip_member(const z_stream& stream)
+			{
+				return stream.avail_in >= 2 && stream.next_in[0] == 0x1f && stream.next_in[1] == 0x8b;
+			}
+
+			void put_le32(std::vector<uint8_t>& out, const uint32_t value)
+			{
+				for (int i = 0; i < 4; i++)
+					out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+			}
+
+			void put_be32(std::vector<uint8_t>& out, const uint32_t value)
+			{
+				for (int i = 3; i >= 0; i--)
+					out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+			}
+
+			struct compressed_block
+			{
+				std::vector<uint8_t> m_data;
+				// crc32 for gzip, adler32 for zlib
+				uLong m_check = 0;
+				int m_result = Z_OK;
+			};
+
+			// raw deflate of one block, all but the last end on a byte boundary so the blocks can be put one after another
+			void compress_block(z_stream& stream, const std::vector<uint8_t>& input_data, const size_t offset, const size_t size, const format output_format, compressed_block& block)
+			{
+				const bool last = offset + size == input_data.size();
+				const auto* data = input_data.data() + offset;
+
+				block.m_check = output_format == format::gzip ? crc32(crc32(0, Z_NULL, 0), data, static_cast<uInt>(size)) : adler32(adler32(0, Z_NULL, 0), data, static_cast<uInt>(size));
+
+				if (block.m_result = deflateReset(&stream); block.m_result != Z_OK)
+					return;
+
+				if (offset != 0)
+				{
+					const size_t dictionary_size = std::min(offset, DICTIONARY_SIZE);
+
+					if (block.m_result = deflateSetDictionary(&stream, data - dictionary_size, static_cast<uInt>(dictionary_size)); block.m_result != Z_OK)
+						return;
+				}
+
+				// room for the sync flush marker on top of the bound
+				block.m_data.resize(deflateBound(&stream, static_cast<uLong>(size)) + 16);
+
+				stream.avail_in = static_cast<uInt>(size);
+				stream.next_in = const_cast<Bytef*>(data);
+				stream.avail_out = static_cast<uInt>(block.m_data.size());
+				stream.next_out = block.m_data.data();
+
+				const int ret = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+
+				if (ret != (last ? Z_STREAM_END : Z_OK) || stream.avail_in != 0)
+				{
+					block.m_result = ret == Z_OK || ret == Z_STREAM_END ? Z_BUF_ERROR : ret;
+					return;
+				}
+
+				block.m_data.resize(block.m_data.size() - stream.avail_out);
+			}
+
+			class context_pool
+			{
+			public:
+				static context_pool& get_instance()
+				{
+					static context_pool instance;
+					return instance;
+				}
+
+				std::unique_ptr<context> acquire_deflate(const int level, const format output_format, int& result)
+				{
+					{
+						std::scoped_lock lock(m_mutex);
+
+						for (auto it = m_deflaters.begin(); it != m_deflaters.end(); it++)
+						{
+							if ((*it)->m_level == level && (*it)->m_format == output_format)
+							{
+								auto rez = std::move(*it);
+								m_deflaters.erase(it);
+								return rez;
+							}
+						}
+					}
+
+					auto rez = std::make_unique<context>();
+
+					if (result = deflateInit2(&rez->m_stream, level, Z_DEFLATED, get_window_bits(output_format), 8, Z_DEFAULT_STRATEGY); result != Z_OK)
+					{
+						return nullptr;
+					}
+
+					rez->m_initialized = true;
+					rez->m_deflate = true;
+					rez->m_level = level;
+					rez->m_format = output_format;
+
+					return rez;
+				}
+
+				std::unique_ptr<context> acquire_inflate(int& result)
+				{
+					{
+						std::scoped_lock lock(m_mutex);
+
+						if (!m_inflaters.empty())
+						{
+							auto rez = std::move(m_inflaters.back());
+							m_inflaters.pop_back();
+							return rez;
+						}
+					}
+
+					auto rez = std::make_unique<context>();
+
+					// 32 detects the gzip or zlib header on its own
+					if (result = inflateInit2(&rez->m_stream, 32 + MAX_WBITS); result != Z_OK)
+					{
+						return nullptr;
+					}
+
+					rez->m_initialized = true;
+
+					return rez;
+				}
+
+				void release(std::unique_ptr<context> released) noexcept
+				{
+					if (released == nullptr)
+					{
+						return;
+					}
+
+					// reset outside of the lock, the next user gets it ready to go
+					if ((released->m_deflate ? deflateReset(&released->m_stream) : inflateReset(&released->m_stream)) != Z_OK)
+					{
+						return;
+					}
+
+					std::scoped_lock lock(m_mutex);
+
+					auto& contexts = released->m_deflate ? m_deflaters : m_inflaters;
+
+					if (contexts.size() < m_max_contexts)
+					{
+						contexts.push_back(std::move(released));
+					}
+				}
+
+				void set_max_contexts(const size_t max_contexts) noexcept
+				{
+					std::scoped_lock lock(m_mutex);
 
-			int ret = inflateInit2(&stream, 16 + MAX_WBITS); // Use zlib format with gzip wrapper
-			if (ret != Z_OK) {
+					m_max_contexts = max_contexts;
+
+					if (m_deflaters.size() > max_contexts)
+						m_deflaters.resize(max_contexts);
+
+					if (m_inflaters.size() > max_contexts)
+						m_inflaters.resize(max_contexts);
+				}
+
+			private:
+				context_pool() = default;
+
+				std::mutex m_mutex;
+				size_t m_max_contexts = 16;
+				std::vector<std::unique_ptr<context>> m_deflaters;
+				std::vector<std::unique_ptr<context>> m_inflaters;
+			};
+		}
+
+		std::vector<uint8_t> decompress(const std::vector<uint8_t>& compressed_data, gzip_error& err, const decompression_limits& limits) noexcept {
+			int ret = Z_OK;
+			auto& pool = context_pool::get_instance();
+			auto inflate_context = pool.acquire_inflate(ret);
+
+			if (inflate_context == nullptr) {
 				err = utile::gzip_error(std::error_code(ret, std::generic_category()), "Failed to initialize zlib");
 				return compressed_data;
 			}
 
+			auto release_context = utile::finally([&pool, &inflate_context]() {
+					pool.release(std::move(inflate_context));
+				});
+
+			auto& stream = inflate_context->m_stream;
+
 			stream.avail_in = static_cast<uInt>(compressed_data.size());
 			stream.next_in = reinterpret_cast<Bytef*>(const_cast<uint8_t*>(compressed_data.data()));
 
-			const size_t buffer_size = 4096;
-			std::vector<uint8_t> buffer(buffer_size);
+			// one byte over the limits is room enough to tell that they were crossed
+			const size_t max_output = get_max_output(limits, compressed_data.size());
+			const size_t max_capacity = max_output == std::numeric_limits<size_t>::max() ? max_output : max_output + 1;
 
-			auto end_inflate = utile::finally([&stream]() {
-					inflateEnd(&stream);
-				});
+			// inflated straight into the result, which doubles whenever it runs full
+			std::vector<uint8_t> decompressed_data(std::min(std::max(compressed_data.size() * EXPECTED_RATIO, MIN_OUTPUT_GROWTH), max_capacity));
+			size_t used = 0;
 
-			do {
-				stream.avail_out = buffer_size;
-				stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+			while (true) {
+				if (used == decompressed_data.size())
+					decompressed_data.resize(std::min(decompressed_data.size() * 2, max_capacity));
+
+				stream.avail_out = static_cast<uInt>(decompressed_data.size() - used);
+				stream.next_out = reinterpret_cast<Bytef*>(decompressed_data.data() + used);
 				ret = inflate(&stream, Z_NO_FLUSH);
 
+				used = decompressed_data.size() - stream.avail_out;
+
 				switch (ret) {
 				case Z_NEED_DICT:
 				case Z_DATA_ERROR:
 				case Z_MEM_ERROR:
-					
+				case Z_STREAM_ERROR:
 					err = utile::gzip_error(std::error_code(ret, std::generic_category()), "Decompression error");
 					return compressed_data;
 				}
 
-				size_t have = buffer_size - stream.avail_out;
-				decompressed_data.insert(decompressed_data.end(), buffer.begin(), buffer.begin() + have);
+				if (used > max_output) {
+					err = make_limit_error();
+					return compressed_data;
+				}
+
+				if (ret == Z_STREAM_END && is_gzip_member(stream)) {
+					inflateReset(&stream);
+					continue;
+				}
 
-			} while (stream.avail_out == 0);
+				// a truncated stream keeps what could be inflated
+				if (ret == Z_STREAM_END || stream.avail_out != 0) {
+					break;
+				}
+			}
+
+			decompressed_data.resize(used);
 
 			return decompressed_data;
 		}
 
-		std::vector<uint8_t> compress(const std::vector<uint8_t>& input_data, gzip_error& err) noexcept
+		std::vector<uint8_t> compress(const std::vector<uint8_t>& input_data, gzip_error& err, const int level, const format output_format) noexcept
 		{
-			std::vector<uint8_t> compressed_data;
+			int ret = Z_OK;
+			auto& pool = context_pool::get_instance();
+			auto deflate_context = pool.acquire_deflate(level, output_format, ret);
 
-			z_stream deflate_stream;
-			deflate_stream.zalloc = Z_NULL;
-			deflate_stream.zfree = Z_NULL;
-			deflate_stream.opaque = Z_NULL;
-			deflate_stream.avail_in = 0;
-			deflate_stream.next_in = Z_NULL;
-
-			if (auto ret = deflateInit2(&deflate_stream, Z_BEST_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY); ret != Z_OK) {
+			if (deflate_context == nullptr) {
 				err = utile::gzip_error(std::error_code(ret, std::generic_category()), "Error initializing deflate stream.");
 				return input_data;
 			}
 
-			const size_t buffer_size = 4096;
-			std::vector<uint8_t> buffer(buffer_size);
+			auto release_context = utile::finally([&pool, &deflate_context]() {
+				pool.release(std::move(deflate_context));
+				});
+
+			auto& deflate_stream = deflate_context->m_stream;
+
+			// the bound always fits the whole stream, one allocation and a single deflate call
+			std::vector<uint8_t> compressed_data(deflateBound(&deflate_stream, static_cast<uLong>(input_data.size())));
 
 			deflate_stream.avail_in = static_cast<uInt>(input_data.size());
 			deflate_stream.next_in = reinterpret_cast<Bytef*>(const_cast<uint8_t*>(input_data.data()));
+			deflate_stream.avail_out = static_cast<uInt>(compressed_data.size());
+			deflate_stream.next_out = reinterpret_cast<Bytef*>(compressed_data.data());
 
-			auto end_deflate = utile::finally([&deflate_stream]() {
-				deflateEnd(&deflate_stream);
-				});
+			if (ret = deflate(&deflate_stream, Z_FINISH); ret != Z_STREAM_END) {
+				err = utile::gzip_error(std::error_code(ret, std::generic_category()), "Error compressing data.");
+				return input_data;
+			}
 
-			do {
-				deflate_stream.avail_out = buffer_size;
-				deflate_stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+			compressed_data.resize(deflate_stream.total_out);
 
-				if (auto ret = deflate(&deflate_stream, Z_FINISH); ret == Z_STREAM_ERROR) {
-					err = utile::gzip_error(std::error_code(ret, std::generic_category()), "Error compressing data.");
+			return compressed_data;
+		}
+
+		std::vector<uint8_t> compress_parallel(const std::vector<uint8_t>& input_data, gzip_error& err, const int level, const format output_format, const size_t nr_threads, const size_t block_size) noexcept try
+		{
+			const size_t size = std::max<size_t>(block_size, DICTIONARY_SIZE);
+			const size_t nr_blocks = (input_data.size() + size - 1) / size;
+			const size_t nr_workers = std::min<size_t>(nr_threads ? nr_threads : std::max(std::thread::hardware_concurrency(), 1u), nr_blocks);
+
+			if (nr_workers <= 1)
+			{
+				return compress(input_data, err, level, output_format);
+			}
+
+			std::vector<compressed_block> blocks(nr_blocks);
+			std::atomic<size_t> next_block = 0;
+
+			auto work = [&]() {
+				context deflate_context;
+
+				if (auto ret = deflateInit2(&deflate_context.m_stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY); ret != Z_OK)
+				{
+					// the blocks left are taken by the other threads, or fail the whole stream if there are none
+					for (size_t i = next_block++; i < nr_blocks; i = next_block++)
+						blocks[i].m_result = ret;
+
+					return;
+				}
+
+				deflate_context.m_initialized = true;
+				deflate_context.m_deflate = true;
+
+				for (size_t i = next_block++; i < nr_blocks; i = next_block++)
+				{
+					const size_t offset = i * size;
+
+					try
+					{
+						compress_block(deflate_context.m_stream, input_data, offset, std::min(size, input_data.size() - offset), output_format, blocks[i]);
+					}
+					catch (const std::bad_alloc&)
+					{
+						blocks[i].m_result = Z_MEM_ERROR;
+					}
+				}
+			};
+
+			// the calling thread is one of the workers
+			std::vector<std::thread> threads;
+
+			for (size_t i = 1; i < nr_workers; i++)
+			{
+				try
+				{
+					threads.emplace_back(work);
+				}
+				catch (const std::system_error&)
+				{
+					// fewer threads share the blocks
+					break;
+				}
+			}
+
+			work();
+
+			for (auto& thread : threads)
+			{
+				thread.join();
+			}
+
+			size_t compressed_size = 0;
+
+			for (const auto& block : blocks)
+			{
+				if (block.m_result != Z_OK)
+				{
+					err = utile::gzip_error(std::error_code(block.m_result, std::generic_category()), "Error compressing data.");
 					return input_data;
 				}
 
-				size_t compressedSize = buffer_size - deflate_stream.avail_out;
-				compressed_data.insert(compressed_data.end(), buffer.begin(), buffer.begin() + compressedSize);
+				compressed_size += block.m_data.size();
+			}
 
-			} while (deflate_stream.avail_out == 0);
+			// the checks of the blocks combined into the one of the whole input
+			uLong check = blocks[0].m_check;
+
+			for (size_t i = 1; i < nr_blocks; i++)
+			{
+				const auto length = static_cast<z_off_t>(std::min(size, input_data.size() - i * size));
+				check = output_format == format::gzip ? crc32_combine(check, blocks[i].m_check, length) : adler32_combine(check, blocks[i].m_check, length);
+			}
+
+			std::vector<uint8_t> compressed_data;
+			compressed_data.reserve(compressed_size + 18);
+
+			if (output_format == format::gzip)
+			{
+				// no name or time, unknown os
+				compressed_data.insert(compressed_data.end(), { 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff });
+			}
+			else
+			{
+				// 32 KB window, the level hint as deflate would set it
+				const int level_hint = level == Z_DEFAULT_COMPRESSION || level == 6 ? 2 : level < 2 ? 0 : level < 6 ? 1 : 3;
+				const int flags = level_hint << 6;
+
+				compressed_data.push_back(0x78);
+				compressed_data.push_back(static_cast<uint8_t>(flags + (31 - (0x78 * 256 + flags) % 31) % 31));
+			}
+
+			for (const auto& block : blocks)
+			{
+				compressed_data.insert(compressed_data.end(), block.m_data.begin(), block.m_data.end());
+			}
+
+			if (output_format == format::gzip)
+			{
+				put_le32(compressed_data, static_cast<uint32_t>(check));
+				put_le32(compressed_data, static_cast<uint32_t>(input_data.size()));
+			}
+			else
+			{
+				put_be32(compressed_data, static_cast<uint32_t>(check));
+			}
 
 			return compressed_data;
 		}
+		catch (const std::exception&)
+		{
+			err = utile::gzip_error(std::error_code(Z_MEM_ERROR, std::generic_category()), "Error compressing data.");
+			return input_data;
+		}
+
+		void set_max_pooled_contexts(const size_t max_contexts) noexcept
+		{
+			context_pool::get_instance().set_max_contexts(max_contexts);
+		}
+
+		struct deflater::state
+		{
+			std::unique_ptr<context> m_context;
+			int m_init_result = Z_OK;
+			// the stream is reset when the next one starts, the counters stay readable until then
+			bool m_finished = false;
+		};
+
+		deflater::deflater(const int level, const format output_format)
+			: m_state(std::make_unique<state>())
+		{
+			m_state->m_context = context_pool::get_instance().acquire_deflate(level, output_format, m_state->m_init_result);
+		}
+
+		deflater::~deflater()
+		{
+			context_pool::get_instance().release(std::move(m_state->m_context));
+		}
+
+		void deflater::feed(const uint8_t* data, const size_t size, std::vector<uint8_t>& out, gzip_error& err) noexcept
+		{
+			if (m_state->m_context == nullptr)
+			{
+				err = utile::gzip_error(std::error_code(m_state->m_init_result, std::generic_category()), "Error initializing deflate stream.");
+				return;
+			}
+
+			if (m_state->m_finished)
+			{
+				reset();
+			}
+
+			auto& stream = m_state->m_context->m_stream;
+
+			stream.avail_in = static_cast<uInt>(size);
+			stream.next_in = reinterpret_cast<Bytef*>(const_cast<uint8_t*>(data));
+
+			run(Z_NO_FLUSH, out, err);
+		}
+
+		void deflater::finish(std::vector<uint8_t>& out, gzip_error& err) noexcept
+		{
+			if (m_state->m_context == nullptr)
+			{
+				err = utile::gzip_error(std::error_code(m_state->m_init_result, std::generic_category()), "Error initializing deflate stream.");
+				return;
+			}
+
+			if (m_state->m_finished)
+			{
+				reset();
+			}
+
+			auto& stream = m_state->m_context->m_stream;
+
+			stream.avail_in = 0;
+			stream.next_in = Z_NULL;
+
+			run(Z_FINISH, out, err);
+
+			m_state->m_finished = true;
+		}
+
+		void deflater::reset() noexcept
+		{
+			if (m_state->m_context != nullptr)
+			{
+				deflateReset(&m_state->m_context->m_stream);
+			}
+
+			m_state->m_finished = false;
+		}
+
+		uint64_t deflater::get_nr_bytes_in() const noexcept
+		{
+			return m_state->m_context ? m_state->m_context->m_stream.total_in : 0;
+		}
+
+		uint64_t deflater::get_nr_bytes_out() const noexcept
+		{
+			return m_state->m_context ? m_state->m_context->m_stream.total_out : 0;
+		}
+
+		void deflater::run(const int flush, std::vector<uint8_t>& out, gzip_error& err) noexcept
+		{
+			auto& stream = m_state->m_context->m_stream;
+
+			size_t used = out.size();
+
+			// sized by zlib's bound for what is pending, growing again is only needed for data buffered by earlier feeds
+			out.resize(used + std::max<size_t>(deflateBound(&stream, stream.avail_in), MIN_OUTPUT_GROWTH));
+
+			int ret = Z_OK;
 
+			do
+			{
+				if (used == out.size())
+					out.resize(used + std::max(used / 2, MIN_OUTPUT_GROWTH));
+
+				stream.avail_out = static_cast<uInt>(out.size() - used);
+				stream.next_out = reinterpret_cast<Bytef*>(out.data() + used);
+
+				ret = deflate(&stream, flush);
+
+				used = out.size() - stream.avail_out;
+
+				if (ret == Z_STREAM_ERROR)
+				{
+					err = utile::gzip_error(std::error_code(ret, std::generic_category()), "Error compressing data.");
+					break;
+				}
+			} while (stream.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+
+			out.resize(used);
+		}
+
+		struct inflater::state
+		{
+			std::unique_ptr<context> m_context;
+			int m_init_result = Z_OK;
+			bool m_finished = false;
+			// totals of the gzip members before the current one, resetting for the next member clears zlib's
+			uint64_t m_nr_bytes_in = 0;
+			uint64_t m_nr_bytes_out = 0;
+			decompression_limits m_limits;
+			std::vector<uint8_t> m_buffer = std::vector<uint8_t>(INFLATE_BUFFER_SIZE);
+		};
+
+		inflater::inflater()
+			: m_state(std::make_unique<state>())
+		{
+			m_state->m_context = context_pool::get_instance().acquire_inflate(m_state->m_init_result);
+		}
+
+		inflater::~inflater()
+		{
+			context_pool::get_instance().release(std::move(m_state->m_context));
+		}
+
+		void inflater::feed(const uint8_t* data, const size_t size, std::ostream& out, gzip_error& err) noexcept
+		{
+			if (m_state->m_context == nullptr)
+			{
+				err = utile::gzip_error(std::error_code(m_state->m_init_result, std::generic_category()), "Failed to initialize zlib");
+				return;
+			}
+
+			auto& stream = m_state->m_context->m_stream;
+			auto& buffer = m_state->m_buffer;
+
+			stream.avail_in = static_cast<uInt>(size);
+			stream.next_in = reinterpret_cast<Bytef*>(const_cast<uint8_t*>(data));
+
+			while (stream.avail_in != 0)
+			{
+				if (m_state->m_finished)
+				{
+					if (!is_gzip_member(stream))
+					{
+						break;
+					}
+
+					m_state->m_nr_bytes_in += stream.total_in;
+					m_state->m_nr_bytes_out += stream.total_out;
+					m_state->m_finished = false;
+					inflateReset(&stream);
+				}
+
+				stream.avail_out = static_cast<uInt>(buffer.size());
+				stream.next_out = reinterpret_cast<Bytef*>(buffer.data());
+
+				auto ret = inflate(&stream, Z_NO_FLUSH);
+
+				switch (ret) {
+				case Z_NEED_DICT:
+				case Z_DATA_ERROR:
+				case Z_MEM_ERROR:
+				case Z_STREAM_ERROR:
+					err = utile::gzip_error(std::error_code(ret, std::generic_category()), "Decompression error");
+					return;
+				}
+
+				if (get_nr_bytes_out() > get_max_output(m_state->m_limits, static_cast<size_t>(get_nr_bytes_in())))
+				{
+					err = make_limit_error();
+					return;
+				}
+
+				out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() - stream.avail_out);
+
+				if (ret == Z_STREAM_END)
+				{
+					m_state->m_finished = true;
+				}
+				else if (ret == Z_BUF_ERROR)
+				{
+					// no progress possible, more input is needed
+					break;
+				}
+			}
+		}
+
+		void inflater::reset() noexcept
+		{
+			if (m_state->m_context != nullptr)
+			{
+				inflateReset(&m_state->m_context->m_stream);
+			}
+
+			m_state->m_finished = false;
+			m_state->m_nr_bytes_in = 0;
+			m_state->m_nr_bytes_out = 0;
+		}
+
+		void inflater::set_limits(const decompression_limits& limits) noexcept
+		{
+			m_state->m_limits = limits;
+		}
+
+		bool inflater::is_finished() const noexcept
+		{
+			return m_state->m_finished;
+		}
+
+		uint64_t inflater::get_nr_bytes_in() const noexcept
+		{
+			return m_state->m_context ? m_state->m_nr_bytes_in + m_state->m_context->m_stream.total_in : 0;
+		}
+
+		uint64_t inflater::get_nr_bytes_out() const noexcept
+		{
+			return m_state->m_context ? m_state->m_nr_bytes_out + m_state->m_context->m_stream.total_out : 0;
+		}
 	}
 }
\ No newline at end of file
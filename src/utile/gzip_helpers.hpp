@@ -1,5 +1,8 @@
 #pragma once
 
+#include <memory>
+#include <ostream>
+#include <system_error>
 #include <vector>
 
 #include "generic_error.hpp"
@@ -8,7 +11,96 @@ namespace utile
 {
 	namespace gzip
 	{
-		std::vector<uint8_t> decompress(const std::vector<uint8_t>& compressed_data, gzip_error& err) noexcept;
-		std::vector<uint8_t> compress(const std::vector<uint8_t>& input_data, gzip_error& err) noexcept;
+		// zlib is the http "deflate" encoding
+		enum class format
+		{
+			gzip,
+			zlib
+		};
+
+		// zlib's levels, 1 is the fastest and 9 the smallest
+		constexpr int DEFAULT_LEVEL = 6;
+		constexpr int BEST_COMPRESSION = 9;
+		// input handed to one thread by compress_parallel
+		constexpr size_t DEFAULT_BLOCK_SIZE = 128 * 1024;
+		// value of the gzip_error of a decompression stopped by its limits
+		constexpr int LIMIT_EXCEEDED = static_cast<int>(std::errc::value_too_large);
+
+		// bounds what a compressed stream may inflate to, 0 leaves a limit off
+		struct decompression_limits
+		{
+			size_t m_max_size = 0;
+			// output per byte of input, only checked past the first MB of output since small bodies legitimately inflate far
+			size_t m_max_ratio = 0;
+		};
+
+		// accepts gzip and zlib streams, gzip streams made of several members are inflated whole;
+		// stops as soon as the output crosses the limits, never holding more than they allow
+		std::vector<uint8_t> decompress(const std::vector<uint8_t>& compressed_data, gzip_error& err, const decompression_limits& limits = decompression_limits()) noexcept;
+		std::vector<uint8_t> compress(const std::vector<uint8_t>& input_data, gzip_error& err, const int level = BEST_COMPRESSION, const format output_format = format::gzip) noexcept;
+		// splits the input into blocks deflated on nr_threads threads (0 for one per core) and joins them into a single
+		// stream any reader accepts; every block is primed with the 32 KB before it, so the output is barely larger than compress's
+		std::vector<uint8_t> compress_parallel(const std::vector<uint8_t>& input_data, gzip_error& err, const int level = DEFAULT_LEVEL,
+			const format output_format = format::gzip, const size_t nr_threads = 0, const size_t block_size = DEFAULT_BLOCK_SIZE) noexcept;
+
+		// z_streams are reset and reused by the next compressor or decompressor instead of being set up again,
+		// the pool keeps a few of each kind, contexts returned over that are freed
+		void set_max_pooled_contexts(const size_t max_contexts) noexcept;
+
+		// compresses a stream pushed in chunks, the output vectors are grown in place without a scratch buffer
+		class deflater
+		{
+		public:
+			deflater(const int level = DEFAULT_LEVEL, const format output_format = format::gzip);
+			~deflater();
+
+			deflater(const deflater&) = delete;
+			deflater& operator=(const deflater&) = delete;
+
+			// appends whatever zlib already produced for data to out, most of it stays buffered until finish
+			void feed(const uint8_t* data, const size_t size, std::vector<uint8_t>& out, gzip_error& err) noexcept;
+			// appends the rest of the stream, the deflater can be used for a new stream afterwards
+			void finish(std::vector<uint8_t>& out, gzip_error& err) noexcept;
+			// drops a stream that wasn't finished
+			void reset() noexcept;
+
+			uint64_t get_nr_bytes_in() const noexcept;
+			uint64_t get_nr_bytes_out() const noexcept;
+
+		private:
+			void run(const int flush, std::vector<uint8_t>& out, gzip_error& err) noexcept;
+
+			struct state;
+			std::unique_ptr<state> m_state;
+		};
+
+		// inflates a gzip or zlib (http deflate) stream piece by piece as it arrives,
+		// only one output buffer is used no matter how large the stream is
+		class inflater
+		{
+		public:
+			inflater();
+			~inflater();
+
+			inflater(const inflater&) = delete;
+			inflater& operator=(const inflater&) = delete;
+
+			// writes everything that can be inflated from data to out, a gzip member following the end of the stream is inflated as well,
+			// any other bytes past the end are ignored
+			void feed(const uint8_t* data, const size_t size, std::ostream& out, gzip_error& err) noexcept;
+			// ready for a new stream
+			void reset() noexcept;
+			// feed fails with LIMIT_EXCEEDED once the stream inflates past them, the ratio is checked against the input so far
+			void set_limits(const decompression_limits& limits) noexcept;
+
+			// true once the end of the stream was reached
+			bool is_finished() const noexcept;
+			uint64_t get_nr_bytes_in() const noexcept;
+			uint64_t get_nr_bytes_out() const noexcept;
+
+		private:
+			struct state;
+			std::unique_ptr<state> m_state;
+		};
 	}
-}
\ No newline at end of file
+}